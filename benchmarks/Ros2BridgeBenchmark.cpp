@@ -0,0 +1,176 @@
+/*
+ * Copyright (c) 2023 Spyrosoft Synergy S.A.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Microbenchmarks of ROS2Bridge over a MockTransport: the cost of one outbound flush cycle, from
+// setProperties() to the values leaving on the session, a fragmented set through a bounded request
+// history, and the inbound sample fan-out.
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "Ros2AllocationCounter.h"
+#include "Ros2Bridge.h"
+#include "Ros2MockTransport.h"
+#include "Ros2PropertyFragments.h"
+
+using aidl::android::hardware::automotive::vehicle::VehiclePropValue;
+using namespace vendor::spyrosoft::vehicle;
+
+namespace {
+
+// HVAC_FAN_SPEED, zoned INT32.
+constexpr int32_t kZonedInt32Prop = 0x15400500;
+// PERF_VEHICLE_SPEED, global FLOAT.
+constexpr int32_t kGlobalFloatProp = 0x11600207;
+// INFO_MAKE, global STRING.
+constexpr int32_t kStringProp = 0x11100101;
+// Requests the reliable stream of micro-ROS holds by default.
+constexpr size_t kReliableHistory = 4;
+constexpr auto kTimeout = std::chrono::seconds(10);
+
+struct BridgeHarness {
+  ros2::MockTransport* transport;
+  std::unique_ptr<ros2::ROS2Bridge> bridge;
+
+  explicit BridgeHarness(size_t history = 0)
+  {
+    auto mock = std::make_unique<ros2::MockTransport>(history);
+    transport = mock.get();
+    bridge = std::make_unique<ros2::ROS2Bridge>(std::move(mock));
+    bridge->start();
+    while (!bridge->is_connected()) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+
+  ~BridgeHarness() { bridge->stop(); }
+};
+
+// One setProperties() call with range(0) areas, until every area has been sent.
+void BM_BridgeFlush(benchmark::State& state)
+{
+  BridgeHarness harness;
+  const auto areas = static_cast<int32_t>(state.range(0));
+
+  std::vector<VehiclePropValue> values;
+  for (int32_t area = 1; area <= areas; area++) {
+    VehiclePropValue value;
+    value.prop = kZonedInt32Prop;
+    value.areaId = area;
+    value.value.int32Values = {area};
+    values.push_back(std::move(value));
+  }
+
+  uint64_t sent = harness.transport->valuesSent();
+  const uint64_t allocationsBefore = allocationCount();
+  for (auto _ : state) {
+    harness.bridge->setProperties(values);
+    sent += values.size();
+    if (!harness.transport->waitForValuesSent(sent, kTimeout)) {
+      state.SkipWithError("values were not sent");
+      break;
+    }
+  }
+
+  const auto valuesTotal = static_cast<double>(state.iterations() * values.size());
+  state.SetItemsProcessed(static_cast<int64_t>(valuesTotal));
+  state.counters["allocs_per_value"] = static_cast<double>(allocationCount() - allocationsBefore) / valuesTotal;
+}
+BENCHMARK(BM_BridgeFlush)->RangeMultiplier(8)->Range(1, 512)->UseRealTime();
+
+// A STRING of range(0) bytes through a transport that holds kReliableHistory unanswered requests,
+// until its last fragment has been sent. Every fragment has to fit in the history.
+void BM_BridgeFragmentedSet(benchmark::State& state)
+{
+  BridgeHarness harness(kReliableHistory);
+
+  VehiclePropValue value;
+  value.prop = kStringProp;
+  value.value.stringValue.assign(static_cast<size_t>(state.range(0)), 'x');
+  const uint64_t fragments =
+      (value.value.stringValue.size() + ros2::kMaxFragmentPayload - 1) / ros2::kMaxFragmentPayload;
+
+  uint64_t sent = harness.transport->valuesSent();
+  for (auto _ : state) {
+    harness.bridge->setProperty(value);
+    sent += fragments;
+    if (!harness.transport->waitForValuesSent(sent, kTimeout)) {
+      state.SkipWithError("fragments were not sent");
+      break;
+    }
+  }
+  if (harness.transport->setsRejected() != 0 || harness.bridge->stats().setSendFailures != 0) {
+    state.SkipWithError("fragments overflowed the history");
+  }
+
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+BENCHMARK(BM_BridgeFragmentedSet)->Arg(4096)->Arg(64 * 1024)->UseRealTime();
+
+// range(0) samples published by the transport, until the update callback has seen all of them.
+void BM_BridgeInboundFanOut(benchmark::State& state)
+{
+  BridgeHarness harness;
+  const auto samples = static_cast<size_t>(state.range(0));
+
+  float speed = 42.0f;
+  ros2_android_vhal__msg__VehicleProperty sample = {};
+  sample.prop_id = kGlobalFloatProp;
+  sample.float_values = {&speed, 1, 1};
+  harness.transport->setSample(sample);
+
+  std::mutex lock;
+  std::condition_variable cv;
+  uint64_t received = 0;
+  harness.bridge->setOnPropertyUpdate([&](VehiclePropValue) {
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      received++;
+    }
+    cv.notify_one();
+  });
+
+  uint64_t expected = 0;
+  const uint64_t allocationsBefore = allocationCount();
+  for (auto _ : state) {
+    harness.transport->publish(samples);
+    expected += samples;
+    std::unique_lock<std::mutex> guard(lock);
+    if (!cv.wait_for(guard, kTimeout, [&]() { return received >= expected; })) {
+      state.SkipWithError("samples were not delivered");
+      break;
+    }
+  }
+
+  const auto samplesTotal = static_cast<double>(state.iterations() * samples);
+  state.SetItemsProcessed(static_cast<int64_t>(samplesTotal));
+  state.counters["allocs_per_sample"] = static_cast<double>(allocationCount() - allocationsBefore) / samplesTotal;
+  // The callback captures locals, stop() joins the session threads before they go away.
+  harness.bridge->stop();
+}
+BENCHMARK(BM_BridgeInboundFanOut)->RangeMultiplier(8)->Range(1, 512)->UseRealTime();
+
+}  // namespace
@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2023 Spyrosoft Synergy S.A.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Round trips through a ROS2Bridge over a LoopbackTransport that echoes every set back as a
+// sample: a STRING value is set, sent in fragments when it is large, and must come back intact.
+
+#include <benchmark/benchmark.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+#include "Ros2Bridge.h"
+#include "Ros2LoopbackTransport.h"
+#include "Ros2PropertyFragments.h"
+
+using aidl::android::hardware::automotive::vehicle::VehiclePropValue;
+using namespace vendor::spyrosoft::vehicle;
+
+namespace {
+
+// INFO_MAKE, global STRING.
+constexpr int32_t kStringProp = 0x11100101;
+constexpr auto kTimeout = std::chrono::seconds(10);
+
+// Sets a STRING of range(0) bytes, until its echo has been received and matches it.
+void BM_LargeStringRoundTrip(benchmark::State& state)
+{
+  ros2::LoopbackTransport::Options options;
+  options.echoSets = true;
+  auto bridge = std::make_unique<ros2::ROS2Bridge>(std::make_unique<ros2::LoopbackTransport>(options));
+
+  std::mutex lock;
+  std::condition_variable cv;
+  std::optional<VehiclePropValue> received;
+  bridge->setOnPropertyUpdate([&](VehiclePropValue value) {
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      received = std::move(value);
+    }
+    cv.notify_one();
+  });
+
+  bridge->start();
+  while (!bridge->is_connected()) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  VehiclePropValue value;
+  value.prop = kStringProp;
+  value.value.stringValue.resize(static_cast<size_t>(state.range(0)));
+  for (size_t i = 0; i < value.value.stringValue.size(); i++) {
+    value.value.stringValue[i] = static_cast<char>('a' + i % 26);
+  }
+
+  for (auto _ : state) {
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      received.reset();
+    }
+    if (!bridge->setProperty(value)) {
+      state.SkipWithError("value was not queued");
+      break;
+    }
+
+    std::unique_lock<std::mutex> guard(lock);
+    if (!cv.wait_for(guard, kTimeout, [&]() { return received.has_value(); })) {
+      state.SkipWithError("echo was not received");
+      break;
+    }
+    if (received->prop != value.prop || received->value.stringValue != value.value.stringValue) {
+      state.SkipWithError("echo differs from the value sent");
+      break;
+    }
+  }
+
+  const auto stats = bridge->stats();
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+  state.counters["fragments_per_value"] =
+      static_cast<double>(stats.fragmentsSent) / static_cast<double>(state.iterations());
+  // The callback captures locals, stop() joins the session threads before they go away.
+  bridge->stop();
+}
+BENCHMARK(BM_LargeStringRoundTrip)
+    ->Arg(64)
+    ->Arg(ros2::kMaxFragmentPayload + 1)
+    ->Arg(4096)
+    ->Arg(64 * 1024)
+    ->UseRealTime();
+
+}  // namespace
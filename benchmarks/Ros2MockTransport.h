@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2023 Spyrosoft Synergy S.A.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <VehicleUtils.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+#include "Ros2PropertyCodec.h"
+#include "Ros2Transport.h"
+
+namespace vendor::spyrosoft::vehicle::ros2 {
+
+/**
+ * @brief Transport with an always reachable agent that answers every set right away and publishes
+ * queued copies of a sample on request, so benchmarks measure the bridge rather than a link.
+ *
+ * With a history, like the reliable stream of micro-ROS, a set is rejected while that many are
+ * unanswered. Answers go out on the next spin().
+ */
+class MockTransport : public Transport {
+ public:
+  explicit MockTransport(size_t history = 0) : m_history(history) {}
+
+  bool discoverAgent() override { return true; }
+  bool pingAgent() override { return true; }
+  void createEntities() override {}
+  void destroyEntities() override {}
+
+  bool sendSetRequest(const ros2_android_vhal__srv__SetVehicleProperty_Request& request) override
+  {
+    const auto& msg = request.prop;
+    size_t values = 1;
+    if (isZonedBatch(msg)) {
+      const bool int64Prop = android::hardware::automotive::vehicle::getPropType(msg.prop_id) ==
+                             aidl::android::hardware::automotive::vehicle::VehiclePropertyType::INT64;
+      values = int64Prop ? msg.int32_values.size : msg.int64_values.size;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(m_lock);
+      if (m_history != 0 && m_unanswered >= m_history) {
+        m_setsRejected++;
+        return false;
+      }
+      m_unanswered++;
+      m_valuesSent += values;
+    }
+    m_cv.notify_all();
+    return true;
+  }
+
+  bool sendGetRequest(const ros2_android_vhal__srv__GetVehicleProperty_Request&) override { return false; }
+
+  void spin(std::chrono::nanoseconds timeout) override
+  {
+    size_t answers;
+    size_t samples;
+    {
+      std::unique_lock<std::mutex> lock(m_lock);
+      m_cv.wait_for(lock, timeout, [this]() { return m_wakeup || m_unanswered != 0 || m_samplesQueued != 0; });
+      m_wakeup = false;
+      answers = m_unanswered;
+      samples = m_samplesQueued;
+      m_unanswered = 0;
+      m_samplesQueued = 0;
+    }
+
+    const ros2_android_vhal__srv__SetVehicleProperty_Response response = {.result = kResultOk};
+    for (size_t i = 0; i < answers && m_onSetResponse; i++) {
+      m_onSetResponse(response);
+    }
+    for (size_t i = 0; i < samples && m_onSample; i++) {
+      m_onSample(m_sample);
+    }
+  }
+
+  void wakeup() override
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_lock);
+      m_wakeup = true;
+    }
+    m_cv.notify_all();
+  }
+
+  // The sample published by publish(), borrowed until the transport is destroyed.
+  void setSample(const ros2_android_vhal__msg__VehicleProperty& sample) { m_sample = sample; }
+
+  // Publishes count copies of the sample from the session thread.
+  void publish(size_t count)
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_lock);
+      m_samplesQueued += count;
+    }
+    m_cv.notify_all();
+  }
+
+  // Waits until values, counting every area of a zoned batch, have been sent in total.
+  bool waitForValuesSent(uint64_t values, std::chrono::milliseconds timeout)
+  {
+    std::unique_lock<std::mutex> lock(m_lock);
+    return m_cv.wait_for(lock, timeout, [this, values]() { return m_valuesSent >= values; });
+  }
+
+  uint64_t valuesSent()
+  {
+    std::lock_guard<std::mutex> lock(m_lock);
+    return m_valuesSent;
+  }
+
+  // Sets that didn't fit in the history.
+  uint64_t setsRejected()
+  {
+    std::lock_guard<std::mutex> lock(m_lock);
+    return m_setsRejected;
+  }
+
+ private:
+  const size_t m_history;
+  std::mutex m_lock;
+  std::condition_variable m_cv;
+  bool m_wakeup = false;
+  size_t m_unanswered = 0;
+  size_t m_samplesQueued = 0;
+  uint64_t m_valuesSent = 0;
+  uint64_t m_setsRejected = 0;
+  ros2_android_vhal__msg__VehicleProperty m_sample = {};
+};
+
+}  // namespace vendor::spyrosoft::vehicle::ros2
@@ -0,0 +1,237 @@
+/*
+ * Copyright (c) 2023 Spyrosoft Synergy S.A.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Microbenchmarks of the property codecs against the encoding they replaced: probing each
+// RawPropValues vector in turn for a value, then dispatching again through a std::variant.
+
+#include <benchmark/benchmark.h>
+#include <rosidl_runtime_c/primitives_sequence_functions.h>
+#include <rosidl_runtime_c/string_functions.h>
+
+#include <string>
+#include <variant>
+
+#include "Ros2AllocationCounter.h"
+#include "Ros2PropertyCodec.h"
+
+using aidl::android::hardware::automotive::vehicle::VehiclePropValue;
+using namespace vendor::spyrosoft::vehicle;
+
+namespace {
+
+// HVAC_FAN_SPEED, zoned INT32.
+constexpr int32_t kInt32Prop = 0x15400500;
+// PERF_VEHICLE_SPEED, global FLOAT.
+constexpr int32_t kFloatProp = 0x11600207;
+// HVAC_FAN_DIRECTION_AVAILABLE, zoned INT32_VEC.
+constexpr int32_t kInt32VecProp = 0x15410582;
+// INFO_MAKE, global STRING.
+constexpr int32_t kStringProp = 0x11100101;
+// A vendor global BYTES property.
+constexpr int32_t kBytesProp = 0x21700100;
+
+VehiclePropValue int32_value()
+{
+  VehiclePropValue value;
+  value.prop = kInt32Prop;
+  value.areaId = 0x1;
+  value.value.int32Values = {3};
+  return value;
+}
+
+VehiclePropValue float_value()
+{
+  VehiclePropValue value;
+  value.prop = kFloatProp;
+  value.value.floatValues = {42.0f};
+  return value;
+}
+
+VehiclePropValue int32_vec_value()
+{
+  VehiclePropValue value;
+  value.prop = kInt32VecProp;
+  value.areaId = 0x1;
+  value.value.int32Values = {1, 2, 3, 6, 8};
+  return value;
+}
+
+VehiclePropValue string_value()
+{
+  VehiclePropValue value;
+  value.prop = kStringProp;
+  value.value.stringValue = std::string(64, 's');
+  return value;
+}
+
+VehiclePropValue bytes_value()
+{
+  VehiclePropValue value;
+  value.prop = kBytesProp;
+  value.value.byteValues.assign(256, 0xa5);
+  return value;
+}
+
+// The previous encoding, kept here as the baseline. It only ever sent the first element.
+using LegacyValue = std::variant<int64_t, int32_t, uint8_t, float, std::string>;
+
+template <class... Ts>
+struct overload : Ts... {
+  using Ts::operator()...;
+};
+template <class... Ts>
+overload(Ts...) -> overload<Ts...>;
+
+bool legacy_encode(const VehiclePropValue& value, ros2_android_vhal__msg__VehicleProperty& msg)
+{
+  LegacyValue legacy;
+  if (!value.value.int64Values.empty())
+    legacy = value.value.int64Values[0];
+  else if (!value.value.floatValues.empty())
+    legacy = value.value.floatValues[0];
+  else if (!value.value.int32Values.empty())
+    legacy = value.value.int32Values[0];
+  else if (!value.value.byteValues.empty())
+    legacy = value.value.byteValues[0];
+  else if (!value.value.stringValue.empty())
+    legacy = value.value.stringValue;
+  else
+    return false;
+
+  msg.timestamp = value.timestamp;
+  msg.area_id = value.areaId;
+  msg.prop_id = value.prop;
+
+  // clang-format off
+  std::visit(overload{
+    [&](int64_t v) {
+      rosidl_runtime_c__int64__Sequence__init(&msg.int64_values, 1UL);
+      msg.int64_values.data[0] = v;
+    },
+    [&](int32_t v) {
+      rosidl_runtime_c__int32__Sequence__init(&msg.int32_values, 1UL);
+      msg.int32_values.data[0] = v;
+    },
+    [&](uint8_t v) {
+      rosidl_runtime_c__uint8__Sequence__init(&msg.uint8_values, 1UL);
+      msg.uint8_values.data[0] = v;
+    },
+    [&](float v) {
+      rosidl_runtime_c__float__Sequence__init(&msg.float_values, 1UL);
+      msg.float_values.data[0] = v;
+    },
+    [&](std::string& v) {
+      rosidl_runtime_c__String__Sequence__init(&msg.string_values, 1UL);
+      rosidl_runtime_c__String__assignn(&msg.string_values.data[0], v.c_str(), v.size());
+    }},
+    legacy);
+  // clang-format on
+  return true;
+}
+
+// The previous decoding copied every field, whatever the property type.
+VehiclePropValue legacy_decode(const ros2_android_vhal__msg__VehicleProperty& msg)
+{
+  VehiclePropValue value;
+  value.timestamp = msg.timestamp;
+  value.areaId = msg.area_id;
+  value.prop = msg.prop_id;
+  value.value.int64Values.assign(msg.int64_values.data, msg.int64_values.data + msg.int64_values.size);
+  value.value.int32Values.assign(msg.int32_values.data, msg.int32_values.data + msg.int32_values.size);
+  value.value.byteValues.assign(msg.uint8_values.data, msg.uint8_values.data + msg.uint8_values.size);
+  value.value.floatValues.assign(msg.float_values.data, msg.float_values.data + msg.float_values.size);
+  if (msg.string_values.size > 0) {
+    value.value.stringValue.assign(msg.string_values.data[0].data, msg.string_values.data[0].size);
+  }
+  return value;
+}
+
+template <typename Encode>
+void run_encode(benchmark::State& state, const VehiclePropValue& value, Encode encode)
+{
+  const uint64_t allocationsBefore = allocationCount();
+  for (auto _ : state) {
+    ros2_android_vhal__msg__VehicleProperty msg;
+    ros2_android_vhal__msg__VehicleProperty__init(&msg);
+    if (!encode(value, msg)) {
+      state.SkipWithError("value was not encoded");
+      ros2_android_vhal__msg__VehicleProperty__fini(&msg);
+      break;
+    }
+    benchmark::DoNotOptimize(msg);
+    ros2_android_vhal__msg__VehicleProperty__fini(&msg);
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.counters["allocs_per_value"] =
+      static_cast<double>(allocationCount() - allocationsBefore) / static_cast<double>(state.iterations());
+}
+
+template <typename Decode>
+void run_decode(benchmark::State& state, const VehiclePropValue& value, Decode decode)
+{
+  ros2_android_vhal__msg__VehicleProperty msg;
+  ros2_android_vhal__msg__VehicleProperty__init(&msg);
+  ros2::encodeProperty(value, msg);
+
+  const uint64_t allocationsBefore = allocationCount();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(decode(msg));
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.counters["allocs_per_value"] =
+      static_cast<double>(allocationCount() - allocationsBefore) / static_cast<double>(state.iterations());
+  ros2_android_vhal__msg__VehicleProperty__fini(&msg);
+}
+
+void BM_LegacyEncode(benchmark::State& state, VehiclePropValue (*make)())
+{
+  run_encode(state, make(), legacy_encode);
+}
+
+void BM_CodecEncode(benchmark::State& state, VehiclePropValue (*make)())
+{
+  run_encode(state, make(), ros2::encodeProperty);
+}
+
+void BM_LegacyDecode(benchmark::State& state, VehiclePropValue (*make)())
+{
+  run_decode(state, make(), legacy_decode);
+}
+
+void BM_CodecDecode(benchmark::State& state, VehiclePropValue (*make)())
+{
+  run_decode(state, make(), ros2::decodeProperty);
+}
+
+#define CODEC_BENCHMARKS(bm)                         \
+  BENCHMARK_CAPTURE(bm, int32, int32_value);         \
+  BENCHMARK_CAPTURE(bm, float, float_value);         \
+  BENCHMARK_CAPTURE(bm, int32_vec, int32_vec_value); \
+  BENCHMARK_CAPTURE(bm, string, string_value);       \
+  BENCHMARK_CAPTURE(bm, bytes, bytes_value)
+
+CODEC_BENCHMARKS(BM_LegacyEncode);
+CODEC_BENCHMARKS(BM_CodecEncode);
+CODEC_BENCHMARKS(BM_LegacyDecode);
+CODEC_BENCHMARKS(BM_CodecDecode);
+
+}  // namespace
@@ -0,0 +1,224 @@
+/*
+ * Copyright (c) 2023 Spyrosoft Synergy S.A.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Microbenchmarks of Ros2VehicleHardware with the bridge on a MockTransport: get and set
+// throughput per batch size, allocations per request, and the property change callback fan-out
+// under concurrent binder callers.
+
+#include <VehicleHalTypes.h>
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "Ros2AllocationCounter.h"
+#include "Ros2Bridge.h"
+#include "Ros2MockTransport.h"
+#include "Ros2VehicleHardware.h"
+
+using aidl::android::hardware::automotive::vehicle::GetValueRequest;
+using aidl::android::hardware::automotive::vehicle::GetValueResult;
+using aidl::android::hardware::automotive::vehicle::SetValueRequest;
+using aidl::android::hardware::automotive::vehicle::SetValueResult;
+using aidl::android::hardware::automotive::vehicle::VehicleProperty;
+using aidl::android::hardware::automotive::vehicle::VehiclePropValue;
+using android::hardware::automotive::vehicle::IVehicleHardware;
+using namespace vendor::spyrosoft::vehicle;
+
+namespace {
+
+constexpr auto kTimeout = std::chrono::seconds(10);
+
+/**
+ * @brief Results delivered to one callback so far, and a way to wait for them.
+ *
+ */
+class ResultCounter {
+ public:
+  void add(size_t results)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mLock);
+      mCount += results;
+    }
+    mCv.notify_all();
+  }
+
+  bool waitFor(uint64_t count)
+  {
+    std::unique_lock<std::mutex> lock(mLock);
+    return mCv.wait_for(lock, kTimeout, [this, count]() { return mCount >= count; });
+  }
+
+ private:
+  std::mutex mLock;
+  std::condition_variable mCv;
+  uint64_t mCount = 0;
+};
+
+/**
+ * @brief Hardware shared by all benchmarks, built once as the constructor loads the whole store.
+ *
+ */
+struct HardwareHarness {
+  std::unique_ptr<Ros2VehicleHardware> hardware;
+  std::vector<int32_t> fanSpeedAreas;
+  std::atomic_uint64_t changeEvents{0};
+  std::atomic_int64_t nextRequestId{0};
+  std::atomic_size_t nextCaller{0};
+
+  HardwareHarness()
+  {
+    Config config;
+    config.snapshotPath.clear();
+    config.recordPath.clear();
+    // Benchmarks overload the workers on purpose, nothing may be shed.
+    config.degradedMode = false;
+
+    auto bridge = std::make_unique<ros2::ROS2Bridge>(std::make_unique<ros2::MockTransport>());
+    ros2::ROS2Bridge* mockBridge = bridge.get();
+    hardware = std::make_unique<Ros2VehicleHardware>(std::move(bridge), config);
+    while (!mockBridge->is_connected()) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    hardware->registerOnPropertyChangeEvent(std::make_unique<const IVehicleHardware::PropertyChangeCallback>(
+        [this](std::vector<VehiclePropValue> values) { changeEvents += values.size(); }));
+
+    for (const auto& propConfig : hardware->getAllPropertyConfigs()) {
+      if (propConfig.prop == static_cast<int32_t>(VehicleProperty::HVAC_FAN_SPEED)) {
+        for (const auto& areaConfig : propConfig.areaConfigs) {
+          fanSpeedAreas.push_back(areaConfig.areaId);
+        }
+      }
+    }
+  }
+};
+
+HardwareHarness& harness()
+{
+  static HardwareHarness instance;
+  return instance;
+}
+
+std::vector<SetValueRequest> makeSetBatch(size_t size, int32_t area)
+{
+  std::vector<SetValueRequest> requests(size);
+  for (size_t i = 0; i < size; i++) {
+    requests[i].requestId = ++harness().nextRequestId;
+    requests[i].value.prop = static_cast<int32_t>(VehicleProperty::HVAC_FAN_SPEED);
+    requests[i].value.areaId = area;
+    requests[i].value.value.int32Values = {static_cast<int32_t>(i % 6 + 1)};
+  }
+  return requests;
+}
+
+// One getValues() call with range(0) requests, until all of them are answered.
+void BM_GetValues(benchmark::State& state)
+{
+  const auto batch = static_cast<size_t>(state.range(0));
+  std::vector<GetValueRequest> requests(batch);
+  for (auto& request : requests) {
+    request.requestId = ++harness().nextRequestId;
+    request.prop.prop = static_cast<int32_t>(VehicleProperty::PERF_VEHICLE_SPEED);
+  }
+
+  ResultCounter answered;
+  auto callback = std::make_shared<const IVehicleHardware::GetValuesCallback>(
+      [&answered](std::vector<GetValueResult> results) { answered.add(results.size()); });
+
+  uint64_t expected = 0;
+  const uint64_t allocationsBefore = allocationCount();
+  for (auto _ : state) {
+    harness().hardware->getValues(callback, requests);
+    expected += batch;
+    if (!answered.waitFor(expected)) {
+      state.SkipWithError("get requests were not answered");
+      break;
+    }
+  }
+
+  const auto requestsTotal = static_cast<double>(state.iterations() * batch);
+  state.SetItemsProcessed(static_cast<int64_t>(requestsTotal));
+  state.counters["allocs_per_request"] = static_cast<double>(allocationCount() - allocationsBefore) / requestsTotal;
+}
+BENCHMARK(BM_GetValues)->RangeMultiplier(4)->Range(1, 256)->UseRealTime();
+
+// One setValues() call with range(0) requests, until all of them are answered. Every set is
+// stored, reported to the change callback and handed to the bridge.
+void BM_SetValues(benchmark::State& state)
+{
+  const auto batch = static_cast<size_t>(state.range(0));
+  const auto requests = makeSetBatch(batch, harness().fanSpeedAreas.front());
+
+  ResultCounter answered;
+  auto callback = std::make_shared<const IVehicleHardware::SetValuesCallback>(
+      [&answered](std::vector<SetValueResult> results) { answered.add(results.size()); });
+
+  uint64_t expected = 0;
+  const uint64_t allocationsBefore = allocationCount();
+  for (auto _ : state) {
+    harness().hardware->setValues(callback, requests);
+    expected += batch;
+    if (!answered.waitFor(expected)) {
+      state.SkipWithError("set requests were not answered");
+      break;
+    }
+  }
+
+  const auto requestsTotal = static_cast<double>(state.iterations() * batch);
+  state.SetItemsProcessed(static_cast<int64_t>(requestsTotal));
+  state.counters["allocs_per_request"] = static_cast<double>(allocationCount() - allocationsBefore) / requestsTotal;
+}
+BENCHMARK(BM_SetValues)->RangeMultiplier(4)->Range(1, 256)->UseRealTime();
+
+// Every thread is a binder caller issuing single sets on its own area and waiting for the answer.
+// Measures how the change callback keeps up as callers are added.
+void BM_ChangeCallbackFanOut(benchmark::State& state)
+{
+  const auto& areas = harness().fanSpeedAreas;
+  const int32_t area = areas[harness().nextCaller++ % areas.size()];
+
+  ResultCounter answered;
+  auto callback = std::make_shared<const IVehicleHardware::SetValuesCallback>(
+      [&answered](std::vector<SetValueResult> results) { answered.add(results.size()); });
+
+  uint64_t expected = 0;
+  const uint64_t eventsBefore = harness().changeEvents;
+  for (auto _ : state) {
+    harness().hardware->setValues(callback, makeSetBatch(1, area));
+    if (!answered.waitFor(++expected)) {
+      state.SkipWithError("set requests were not answered");
+      break;
+    }
+  }
+
+  state.SetItemsProcessed(state.iterations());
+  // Every caller sees the events of all of them, averaged back to the total rate.
+  state.counters["change_events"] = benchmark::Counter(static_cast<double>(harness().changeEvents - eventsBefore),
+                                                       benchmark::Counter::kAvgThreadsRate);
+}
+BENCHMARK(BM_ChangeCallbackFanOut)->ThreadRange(1, 8)->UseRealTime();
+
+}  // namespace
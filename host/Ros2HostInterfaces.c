@@ -0,0 +1,240 @@
+/*
+ * Copyright (c) 2023 Spyrosoft Synergy S.A.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Host build of the ros2_android_vhal interfaces and the part of the rosidl C runtime the bridge
+// uses. On the device both come from the micro-ROS library, these follow the same contracts:
+// init zero-initializes, fini releases and may be called on a zero-initialized value.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "ros2_android_vhal/msg/vehicle_property.h"
+#include "ros2_android_vhal/srv/get_vehicle_property.h"
+#include "ros2_android_vhal/srv/set_vehicle_property.h"
+#include "rosidl_runtime_c/primitives_sequence_functions.h"
+#include "rosidl_runtime_c/string_functions.h"
+
+#define ROS2_VHAL_HOST_SEQUENCE_FUNCTIONS(NAME, TYPE)                                               \
+  bool rosidl_runtime_c__##NAME##__Sequence__init(rosidl_runtime_c__##NAME##__Sequence* sequence, \
+                                                  size_t size)                                     \
+  {                                                                                                \
+    if (sequence == NULL) {                                                                        \
+      return false;                                                                                \
+    }                                                                                              \
+    TYPE* data = NULL;                                                                             \
+    if (size > 0) {                                                                                \
+      data = (TYPE*)calloc(size, sizeof(TYPE));                                                    \
+      if (data == NULL) {                                                                          \
+        return false;                                                                              \
+      }                                                                                            \
+    }                                                                                              \
+    sequence->data = data;                                                                         \
+    sequence->size = size;                                                                         \
+    sequence->capacity = size;                                                                     \
+    return true;                                                                                   \
+  }                                                                                                \
+                                                                                                   \
+  void rosidl_runtime_c__##NAME##__Sequence__fini(rosidl_runtime_c__##NAME##__Sequence* sequence)  \
+  {                                                                                                \
+    if (sequence == NULL) {                                                                        \
+      return;                                                                                      \
+    }                                                                                              \
+    free(sequence->data);                                                                          \
+    sequence->data = NULL;                                                                         \
+    sequence->size = 0;                                                                            \
+    sequence->capacity = 0;                                                                        \
+  }
+
+ROS2_VHAL_HOST_SEQUENCE_FUNCTIONS(float, float)
+ROS2_VHAL_HOST_SEQUENCE_FUNCTIONS(uint8, uint8_t)
+ROS2_VHAL_HOST_SEQUENCE_FUNCTIONS(int32, int32_t)
+ROS2_VHAL_HOST_SEQUENCE_FUNCTIONS(int64, int64_t)
+
+#undef ROS2_VHAL_HOST_SEQUENCE_FUNCTIONS
+
+bool rosidl_runtime_c__String__init(rosidl_runtime_c__String* str)
+{
+  if (str == NULL) {
+    return false;
+  }
+  str->data = (char*)calloc(1, 1);
+  if (str->data == NULL) {
+    return false;
+  }
+  str->size = 0;
+  str->capacity = 1;
+  return true;
+}
+
+void rosidl_runtime_c__String__fini(rosidl_runtime_c__String* str)
+{
+  if (str == NULL) {
+    return;
+  }
+  free(str->data);
+  str->data = NULL;
+  str->size = 0;
+  str->capacity = 0;
+}
+
+bool rosidl_runtime_c__String__assignn(rosidl_runtime_c__String* str, const char* value, size_t n)
+{
+  if (str == NULL || value == NULL || n == SIZE_MAX) {
+    return false;
+  }
+  char* data = (char*)realloc(str->data, n + 1);
+  if (data == NULL) {
+    return false;
+  }
+  memcpy(data, value, n);
+  data[n] = '\0';
+  str->data = data;
+  str->size = n;
+  str->capacity = n + 1;
+  return true;
+}
+
+bool rosidl_runtime_c__String__assign(rosidl_runtime_c__String* str, const char* value)
+{
+  return value != NULL && rosidl_runtime_c__String__assignn(str, value, strlen(value));
+}
+
+bool rosidl_runtime_c__String__Sequence__init(rosidl_runtime_c__String__Sequence* sequence, size_t size)
+{
+  if (sequence == NULL) {
+    return false;
+  }
+  rosidl_runtime_c__String* data = NULL;
+  if (size > 0) {
+    data = (rosidl_runtime_c__String*)calloc(size, sizeof(rosidl_runtime_c__String));
+    if (data == NULL) {
+      return false;
+    }
+    for (size_t i = 0; i < size; i++) {
+      if (!rosidl_runtime_c__String__init(&data[i])) {
+        for (size_t j = 0; j < i; j++) {
+          rosidl_runtime_c__String__fini(&data[j]);
+        }
+        free(data);
+        return false;
+      }
+    }
+  }
+  sequence->data = data;
+  sequence->size = size;
+  sequence->capacity = size;
+  return true;
+}
+
+void rosidl_runtime_c__String__Sequence__fini(rosidl_runtime_c__String__Sequence* sequence)
+{
+  if (sequence == NULL) {
+    return;
+  }
+  for (size_t i = 0; i < sequence->capacity; i++) {
+    rosidl_runtime_c__String__fini(&sequence->data[i]);
+  }
+  free(sequence->data);
+  sequence->data = NULL;
+  sequence->size = 0;
+  sequence->capacity = 0;
+}
+
+bool ros2_android_vhal__msg__VehicleProperty__init(ros2_android_vhal__msg__VehicleProperty* msg)
+{
+  if (msg == NULL) {
+    return false;
+  }
+  memset(msg, 0, sizeof(*msg));
+  return true;
+}
+
+void ros2_android_vhal__msg__VehicleProperty__fini(ros2_android_vhal__msg__VehicleProperty* msg)
+{
+  if (msg == NULL) {
+    return;
+  }
+  rosidl_runtime_c__int64__Sequence__fini(&msg->int64_values);
+  rosidl_runtime_c__int32__Sequence__fini(&msg->int32_values);
+  rosidl_runtime_c__uint8__Sequence__fini(&msg->uint8_values);
+  rosidl_runtime_c__float__Sequence__fini(&msg->float_values);
+  rosidl_runtime_c__String__Sequence__fini(&msg->string_values);
+}
+
+bool ros2_android_vhal__srv__SetVehicleProperty_Request__init(ros2_android_vhal__srv__SetVehicleProperty_Request* msg)
+{
+  return msg != NULL && ros2_android_vhal__msg__VehicleProperty__init(&msg->prop);
+}
+
+void ros2_android_vhal__srv__SetVehicleProperty_Request__fini(ros2_android_vhal__srv__SetVehicleProperty_Request* msg)
+{
+  if (msg != NULL) {
+    ros2_android_vhal__msg__VehicleProperty__fini(&msg->prop);
+  }
+}
+
+bool ros2_android_vhal__srv__SetVehicleProperty_Response__init(ros2_android_vhal__srv__SetVehicleProperty_Response* msg)
+{
+  if (msg == NULL) {
+    return false;
+  }
+  msg->result = 0;
+  return true;
+}
+
+void ros2_android_vhal__srv__SetVehicleProperty_Response__fini(
+    ros2_android_vhal__srv__SetVehicleProperty_Response* msg)
+{
+  (void)msg;
+}
+
+bool ros2_android_vhal__srv__GetVehicleProperty_Request__init(ros2_android_vhal__srv__GetVehicleProperty_Request* msg)
+{
+  if (msg == NULL) {
+    return false;
+  }
+  msg->prop_id = 0;
+  msg->area_id = 0;
+  return true;
+}
+
+void ros2_android_vhal__srv__GetVehicleProperty_Request__fini(ros2_android_vhal__srv__GetVehicleProperty_Request* msg)
+{
+  (void)msg;
+}
+
+bool ros2_android_vhal__srv__GetVehicleProperty_Response__init(ros2_android_vhal__srv__GetVehicleProperty_Response* msg)
+{
+  if (msg == NULL) {
+    return false;
+  }
+  msg->result = 0;
+  return ros2_android_vhal__msg__VehicleProperty__init(&msg->prop);
+}
+
+void ros2_android_vhal__srv__GetVehicleProperty_Response__fini(
+    ros2_android_vhal__srv__GetVehicleProperty_Response* msg)
+{
+  if (msg != NULL) {
+    ros2_android_vhal__msg__VehicleProperty__fini(&msg->prop);
+  }
+}
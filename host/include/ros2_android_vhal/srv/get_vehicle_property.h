@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2023 Spyrosoft Synergy S.A.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "ros2_android_vhal/msg/vehicle_property.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct ros2_android_vhal__srv__GetVehicleProperty_Request {
+  int32_t prop_id;
+  int32_t area_id;
+} ros2_android_vhal__srv__GetVehicleProperty_Request;
+
+typedef struct ros2_android_vhal__srv__GetVehicleProperty_Response {
+  int32_t result;
+  ros2_android_vhal__msg__VehicleProperty prop;
+} ros2_android_vhal__srv__GetVehicleProperty_Response;
+
+bool ros2_android_vhal__srv__GetVehicleProperty_Request__init(ros2_android_vhal__srv__GetVehicleProperty_Request* msg);
+void ros2_android_vhal__srv__GetVehicleProperty_Request__fini(ros2_android_vhal__srv__GetVehicleProperty_Request* msg);
+bool ros2_android_vhal__srv__GetVehicleProperty_Response__init(ros2_android_vhal__srv__GetVehicleProperty_Response* msg);
+void ros2_android_vhal__srv__GetVehicleProperty_Response__fini(ros2_android_vhal__srv__GetVehicleProperty_Response* msg);
+
+#ifdef __cplusplus
+}
+#endif
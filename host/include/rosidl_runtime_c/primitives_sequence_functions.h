@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) 2023 Spyrosoft Synergy S.A.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+
+#include "rosidl_runtime_c/primitives_sequence.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+bool rosidl_runtime_c__float__Sequence__init(rosidl_runtime_c__float__Sequence* sequence, size_t size);
+void rosidl_runtime_c__float__Sequence__fini(rosidl_runtime_c__float__Sequence* sequence);
+bool rosidl_runtime_c__uint8__Sequence__init(rosidl_runtime_c__uint8__Sequence* sequence, size_t size);
+void rosidl_runtime_c__uint8__Sequence__fini(rosidl_runtime_c__uint8__Sequence* sequence);
+bool rosidl_runtime_c__int32__Sequence__init(rosidl_runtime_c__int32__Sequence* sequence, size_t size);
+void rosidl_runtime_c__int32__Sequence__fini(rosidl_runtime_c__int32__Sequence* sequence);
+bool rosidl_runtime_c__int64__Sequence__init(rosidl_runtime_c__int64__Sequence* sequence, size_t size);
+void rosidl_runtime_c__int64__Sequence__fini(rosidl_runtime_c__int64__Sequence* sequence);
+
+#ifdef __cplusplus
+}
+#endif
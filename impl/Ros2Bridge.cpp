@@ -22,209 +22,595 @@
 
 #include "Ros2Bridge.h"
 
-#include <aidl/android/hardware/automotive/vehicle/VehicleProperty.h>
-#include <rcl/error_handling.h>
-#include <rmw_microros/discovery.h>
-#include <rmw_microros/error_handling.h>
-#include <rmw_microros/ping.h>
-#include <rmw_microros/rmw_microros.h>
-#include <rosidl_runtime_c/primitives_sequence_functions.h>
-#include <rosidl_runtime_c/string_functions.h>
-#include <unistd.h>
+#include <utils/SystemClock.h>
 
+#include <algorithm>
+
+#include "Ros2PropertyCodec.h"
 #include "common/logging.hpp"
 
-#define RCCHECK(fn)                                                               \
-  {                                                                               \
-    rcl_ret_t temp_rc = fn;                                                       \
-    if ((temp_rc != RCL_RET_OK)) {                                                \
-      ALOGE("Failed status on line %d: %d. Aborting.\n", __LINE__, (int)temp_rc); \
-      abort();                                                                    \
-    }                                                                             \
-  }
-#define RCSOFTCHECK(fn)                                                             \
-  {                                                                                 \
-    rcl_ret_t temp_rc = fn;                                                         \
-    if ((temp_rc != RCL_RET_OK)) {                                                  \
-      ALOGE("Failed status on line %d: %d. Continuing.\n", __LINE__, (int)temp_rc); \
-    }                                                                               \
-  }
+namespace vendor::spyrosoft::vehicle::ros2 {
+
+namespace {
 
-// helper types for the visitor
-template <class... Ts>
-struct overload : Ts... {
-  using Ts::operator()...;
-};
-template <class... Ts>
-overload(Ts...) -> overload<Ts...>;
+// Liveness of a connected agent is checked at this interval, in between the session thread only
+// wakes up for incoming data or queued requests.
+constexpr std::chrono::seconds kPingInterval{1};
 
-static ros2_android_vhal__srv__SetVehicleProperty_Response set_vehicle_property_resp;
+// Clock offset is resampled at this interval, the drift estimate covers the time in between.
+constexpr std::chrono::seconds kClockSyncInterval{10};
 
-void set_vehicle_property_callback(const void *msg)
+// A set unanswered for this long is considered lost and no longer counts for the round trip.
+constexpr int64_t kAckTimeoutNs = 5'000'000'000;
+
+// Unanswered fragments of a transfer. micro-ROS keeps 4 requests in the history of its reliable
+// stream by default and fails a request that doesn't fit, half of it is left to other sets.
+constexpr size_t kMaxFragmentsInFlight = 2;
+
+std::vector<std::unique_ptr<Transport>> single_transport(std::unique_ptr<Transport> transport)
 {
-  auto *resp = static_cast<const ros2_android_vhal__srv__SetVehicleProperty_Response *>(msg);
-  ALOGD("set_vehicle_property_callback result: %d", resp->result);
+  std::vector<std::unique_ptr<Transport>> transports;
+  transports.push_back(std::move(transport));
+  return transports;
 }
 
-namespace vendor::spyrosoft::vehicle::ros2 {
+}  // namespace
+
+ROS2Bridge::ROS2Bridge(std::unique_ptr<Transport> transport)
+    : ROS2Bridge(single_transport(std::move(transport)), [](int32_t) { return size_t{0}; })
+{
+}
 
-ROS2Bridge::ROS2Bridge()
-    : m_init_options(rcl_get_zero_initialized_init_options()),
-      m_allocator(rcutils_get_default_allocator()),
-      m_node(rcl_get_zero_initialized_node()),
-      m_executor(rclc_executor_get_zero_initialized_executor()),
-      m_vehiclePropertyClient(rcl_get_zero_initialized_client())
+ROS2Bridge::ROS2Bridge(std::vector<std::unique_ptr<Transport>> transports, SessionRouter router)
+    : m_router(std::move(router))
 {
-  RCCHECK(rcl_init_options_init(&m_init_options, m_allocator));
-  ALOGI("ROS 2 Bridge created");
+  for (auto &transport : transports) {
+    const size_t index = m_sessions.size();
+    auto session = std::make_unique<Session>();
+    session->transport = std::move(transport);
+    session->transport->setCallbacks(
+        [this, index](const ros2_android_vhal__msg__VehicleProperty &msg) { handleVehicleProperty(index, msg); },
+        [this, index](const ros2_android_vhal__srv__SetVehicleProperty_Response &response) {
+          handleSetResponse(index, response);
+        },
+        [this, index](const ros2_android_vhal__srv__GetVehicleProperty_Response &response) {
+          handleGetResponse(index, response);
+        });
+    m_sessions.push_back(std::move(session));
+  }
+  ALOGI("ROS 2 Bridge created with %zu sessions", m_sessions.size());
 }
 
 ROS2Bridge::~ROS2Bridge()
 {
   stop();
-  destroyEntities();
-  RCSOFTCHECK(rcl_init_options_fini(&m_init_options));
 }
 
-void ROS2Bridge::createEntities()
+bool ROS2Bridge::is_connected() const
+{
+  for (const auto &session : m_sessions) {
+    if (session->state == AgentConnectionState::CONNECTED) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void ROS2Bridge::setOnPropertyUpdate(PropertyUpdateCallback callback)
+{
+  m_onPropertyUpdate = std::move(callback);
+}
+
+void ROS2Bridge::setOnPropertyBatch(PropertyBatchCallback callback)
 {
-  ALOGI("ROS2Bridge - initializing node entities");
+  m_onPropertyBatch = std::move(callback);
+}
 
-  if (m_rmw_options != nullptr) {
-    RCCHECK(rclc_support_init_with_options(&m_support, 0, nullptr, &m_init_options, &m_allocator));
+void ROS2Bridge::setOnGetResponse(GetResponseCallback callback)
+{
+  m_onGetResponse = std::move(callback);
+}
+
+BridgeStats ROS2Bridge::stats() const
+{
+  std::vector<ClockSync::State> clocks;
+  std::vector<SessionHealth> sessions;
+  uint64_t transfersDropped = 0;
+  for (const auto &session : m_sessions) {
+    clocks.push_back(session->clock.state());
+    sessions.push_back({
+        .connected = session->state == AgentConnectionState::CONNECTED,
+        .heartbeats = session->heartbeats,
+        .lastHeartbeatNs = session->lastHeartbeatNs,
+    });
+    transfersDropped += session->assembler.dropped();
   }
-  else {
-    RCCHECK(rclc_support_init(&m_support, 0, nullptr, &m_allocator));
+
+  return BridgeStats{
+      .connects = m_connects,
+      .disconnects = m_disconnects,
+      .setsSent = m_setsSent,
+      .setSendFailures = m_setSendFailures,
+      .setsAcked = m_setsAcked,
+      .setsRejected = m_setsRejected,
+      .samplesReceived = m_samplesReceived,
+      .getsSent = m_getsSent,
+      .getsAnswered = m_getsAnswered,
+      .fragmentsSent = m_fragmentsSent,
+      .transfersReceived = m_transfersReceived,
+      .transfersDropped = transfersDropped,
+      .zonedBatchesSent = m_zonedBatchesSent,
+      .zonedBatchesReceived = m_zonedBatchesReceived,
+      .inboundLatency = m_inboundLatency.summary(),
+      .outboundQueueing = m_outboundQueueing.summary(),
+      .setRoundTrip = m_setRoundTrip.summary(),
+      .clocks = std::move(clocks),
+      .sessions = std::move(sessions),
+  };
+}
+
+void ROS2Bridge::stop()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_stateMutex);
+    m_running = false;
   }
+  m_stopCv.notify_all();
+  for (auto &session : m_sessions) {
+    session->transport->wakeup();
+  }
+
+  // Callbacks run on the session threads, none may run once stop() returned.
+  for (auto &session : m_sessions) {
+    if (session->thread.joinable()) {
+      session->thread.join();
+    }
+    dropOutbound(*session);
+  }
+}
+
+bool ROS2Bridge::setProperty(const aidl::android::hardware::automotive::vehicle::VehiclePropValue &value)
+{
+  return setProperties({value});
+}
+
+bool ROS2Bridge::setProperties(std::vector<aidl::android::hardware::automotive::vehicle::VehiclePropValue> values)
+{
+  bool queuedAll = true;
+  std::vector<Session *> touched;
 
-  RCCHECK(rclc_node_init_default(&m_node, "android_vhal_node", "", &m_support));
+  for (auto &value : values) {
+    const int32_t propId = value.prop;
+    Session *session = connectedSession(propId);
+    if (session == nullptr) {
+      m_setSendFailures++;
+      ALOGW("setProperty(%d) - session is not connected", propId);
+      queuedAll = false;
+      continue;
+    }
 
-  RCCHECK(rclc_client_init_default(&m_vehiclePropertyClient, &m_node,
-                                   ROSIDL_GET_SRV_TYPE_SUPPORT(ros2_android_vhal, srv, SetVehicleProperty),
-                                   "/set_vehicle_property"));
+    if (!isEncodable(value)) {
+      m_setSendFailures++;
+      ALOGE("setProperty(%d) - value does not match the property type", propId);
+      queuedAll = false;
+      continue;
+    }
 
-  RCCHECK(rclc_executor_init(&m_executor, &m_support.context, 1, &m_allocator));
+    // Encoding waits for the session thread, which may batch or fragment the value.
+    {
+      std::lock_guard<std::mutex> lock(session->outboundLock);
+      session->outbound.push_back(
+          {std::make_shared<const aidl::android::hardware::automotive::vehicle::VehiclePropValue>(std::move(value)),
+           android::elapsedRealtimeNano()});
+    }
+    if (std::find(touched.begin(), touched.end(), session) == touched.end()) {
+      touched.push_back(session);
+    }
+  }
 
-  RCCHECK(rclc_executor_add_client(&m_executor, &m_vehiclePropertyClient, &set_vehicle_property_resp,
-                                   set_vehicle_property_callback));
+  for (Session *session : touched) {
+    session->transport->wakeup();
+  }
+  return queuedAll;
 }
 
-void ROS2Bridge::destroyEntities()
+bool ROS2Bridge::getProperty(int32_t propId, int32_t areaId)
 {
-  ALOGI("ROS2Bridge - destroying node entities");
+  Session *session = connectedSession(propId);
+  if (session == nullptr) {
+    return false;
+  }
+
+  ros2_android_vhal__srv__GetVehicleProperty_Request req;
+  ros2_android_vhal__srv__GetVehicleProperty_Request__init(&req);
+  req.prop_id = propId;
+  req.area_id = areaId;
+
+  {
+    std::lock_guard<std::mutex> lock(session->outboundLock);
+    session->outboundGets.push_back(req);
+  }
+  session->transport->wakeup();
 
-  RCSOFTCHECK(rclc_executor_fini(&m_executor));
-  RCSOFTCHECK(rcl_client_fini(&m_vehiclePropertyClient, &m_node));
-  RCSOFTCHECK(rcl_node_fini(&m_node));
-  RCSOFTCHECK(rclc_support_fini(&m_support));
+  return true;
 }
 
-bool ROS2Bridge::pingAgent()
+ROS2Bridge::Session *ROS2Bridge::connectedSession(int32_t propId)
 {
-  if (m_rmw_options != nullptr) {
-    return (rmw_uros_ping_agent_options(250, 5, m_rmw_options) == RMW_RET_OK);
+  const size_t index = m_router(propId);
+  if (index >= m_sessions.size() || m_sessions[index]->state != AgentConnectionState::CONNECTED) {
+    return nullptr;
   }
-  else {
-    return (rmw_uros_ping_agent(250, 5) == RMW_RET_OK);
+  return m_sessions[index].get();
+}
+
+void ROS2Bridge::flushOutbound(Session &session)
+{
+  expireAcks(session, android::elapsedRealtimeNano());
+  // Sets queued behind a transfer wait for it, so a large value never overtakes a later one.
+  const bool transferDone = continueTransfer(session);
+
+  std::deque<OutboundSet> outbound;
+  std::deque<ros2_android_vhal__srv__GetVehicleProperty_Request> outboundGets;
+  {
+    std::lock_guard<std::mutex> lock(session.outboundLock);
+    if (transferDone) {
+      outbound.swap(session.outbound);
+    }
+    outboundGets.swap(session.outboundGets);
+  }
+
+  std::vector<bool> done(outbound.size(), false);
+  for (size_t i = 0; i < outbound.size(); i++) {
+    if (done[i]) {
+      continue;
+    }
+    const auto &value = *outbound[i].value;
+    m_outboundQueueing.record(android::elapsedRealtimeNano() - outbound[i].queuedAt);
+
+    if (needsFragmentation(value)) {
+      session.transfer = OutboundTransfer{outbound[i].value, m_nextTransferId++, 0};
+      if (!continueTransfer(session)) {
+        std::lock_guard<std::mutex> lock(session.outboundLock);
+        for (size_t j = outbound.size(); j > i + 1; j--) {
+          if (!done[j - 1]) {
+            session.outbound.push_front(std::move(outbound[j - 1]));
+          }
+        }
+        break;
+      }
+      continue;
+    }
+
+    // Every queued area of a zoned property goes out together, the latest value of an area wins.
+    std::vector<const aidl::android::hardware::automotive::vehicle::VehiclePropValue *> batch{&value};
+    if (isBatchable(value.prop)) {
+      for (size_t j = i + 1; j < outbound.size(); j++) {
+        const auto &other = *outbound[j].value;
+        if (done[j] || other.prop != value.prop) {
+          continue;
+        }
+        done[j] = true;
+        m_outboundQueueing.record(android::elapsedRealtimeNano() - outbound[j].queuedAt);
+
+        auto sameArea = std::find_if(batch.begin(), batch.end(),
+                                     [&other](const auto *queued) { return queued->areaId == other.areaId; });
+        if (sameArea != batch.end()) {
+          *sameArea = &other;
+        }
+        else {
+          batch.push_back(&other);
+        }
+      }
+    }
+
+    ros2_android_vhal__srv__SetVehicleProperty_Request req;
+    ros2_android_vhal__srv__SetVehicleProperty_Request__init(&req);
+    const bool encoded = batch.size() > 1 ? encodeZonedBatch(batch, req.prop) : encodeProperty(*batch[0], req.prop);
+    if (!encoded || !session.transport->sendSetRequest(req)) {
+      m_setSendFailures++;
+      ALOGE("rcl_send_request setProperty(%d) error", value.prop);
+    }
+    else {
+      m_setsSent++;
+      if (batch.size() > 1) {
+        m_zonedBatchesSent++;
+      }
+      awaitAck(session, android::elapsedRealtimeNano(), false);
+      ALOGD("rcl_send_request setProperty(%d) sent, %zu areas", value.prop, batch.size());
+    }
+    ros2_android_vhal__srv__SetVehicleProperty_Request__fini(&req);
+  }
+
+  for (auto &req : outboundGets) {
+    if (!session.transport->sendGetRequest(req)) {
+      ALOGE("rcl_send_request getProperty(%d) error", req.prop_id);
+      if (m_onGetResponse) {
+        m_onGetResponse(req.prop_id, req.area_id, std::nullopt);
+      }
+    }
+    else {
+      m_getsSent++;
+    }
+    ros2_android_vhal__srv__GetVehicleProperty_Request__fini(&req);
   }
 }
 
-bool ROS2Bridge::setProperty(int64_t timestamp, int32_t areaId, int32_t propId, PropertyValue_t value)
+bool ROS2Bridge::continueTransfer(Session &session)
 {
-  if (propId != 0x15400500) {
+  if (!session.transfer) {
     return true;
   }
 
-  std::lock_guard<std::mutex> lock(m_clientMutex);
-
-  ros2_android_vhal__srv__SetVehicleProperty_Request req;
-  ros2_android_vhal__srv__SetVehicleProperty_Request__init(&req);
-  req.prop.timestamp = timestamp;
-  req.prop.area_id = areaId;
-  req.prop.prop_id = propId;
-
-  // clang-format off
-  std::visit(overload{
-    [&](int64_t) {
-      rosidl_runtime_c__int64__Sequence__init(&req.prop.int64_values, 1UL);
-      req.prop.int64_values.data[0] = std::get<int64_t>(value);
-    },
-    [&](int32_t) { 
-      rosidl_runtime_c__int32__Sequence__init(&req.prop.int32_values, 1UL);
-      req.prop.int32_values.data[0] = std::get<int32_t>(value);
-    },
-    [&](uint8_t) { 
-      rosidl_runtime_c__uint8__Sequence__init(&req.prop.uint8_values, 1UL);
-      req.prop.uint8_values.data[0] = std::get<uint8_t>(value);
-    },
-    [&](float) { 
-      rosidl_runtime_c__float__Sequence__init(&req.prop.float_values, 1UL);
-      req.prop.float_values.data[0] = std::get<float>(value);
-    },
-    [&](std::string&) { 
-      rosidl_runtime_c__String__Sequence__init(&req.prop.string_values, 1UL);
-      rosidl_runtime_c__String__assignn(&req.prop.string_values.data[0], std::get<std::string>(value).c_str(), std::get<std::string>(value).size());
-    }},
-    value);
-  // clang-format on
-
-  int64_t sequence_number;
-  const auto send_result = rcl_send_request(&m_vehiclePropertyClient, &req, &sequence_number);
-  ros2_android_vhal__srv__SetVehicleProperty_Request__fini(&req);
-
-  if (send_result != RMW_RET_OK) {
-    ALOGE("rcl_send_request setProperty(%d) error", propId);
-    return false;
+  auto &transfer = *session.transfer;
+  const auto &value = *transfer.value;
+  while (session.fragmentsInFlight < kMaxFragmentsInFlight) {
+    const PropertyFragment fragment(value, transfer.id, transfer.offset);
+    ros2_android_vhal__srv__SetVehicleProperty_Request req = {};
+    req.prop = fragment.msg();
+    if (!session.transport->sendSetRequest(req)) {
+      m_setSendFailures++;
+      ALOGE("rcl_send_request setProperty(%d) fragment error", value.prop);
+      session.transfer.reset();
+      return true;
+    }
+    // Every fragment is answered on its own.
+    awaitAck(session, android::elapsedRealtimeNano(), true);
+    m_fragmentsSent++;
+    transfer.offset += fragment.size();
+
+    if (transfer.offset >= fragment.totalSize()) {
+      m_setsSent++;
+      ALOGD("rcl_send_request setProperty(%d) sent in fragments, %zu bytes", value.prop, transfer.offset);
+      session.transfer.reset();
+      return true;
+    }
+  }
+  return false;
+}
+
+void ROS2Bridge::awaitAck(Session &session, int64_t sentAt, bool fragment)
+{
+  expireAcks(session, sentAt);
+  session.awaitingAck.push_back({sentAt, fragment});
+  if (fragment) {
+    session.fragmentsInFlight++;
+  }
+}
+
+void ROS2Bridge::expireAcks(Session &session, int64_t now)
+{
+  while (!session.awaitingAck.empty() && now - session.awaitingAck.front().sentAt > kAckTimeoutNs) {
+    popAck(session);
+  }
+}
+
+void ROS2Bridge::popAck(Session &session)
+{
+  if (session.awaitingAck.front().fragment) {
+    session.fragmentsInFlight--;
+  }
+  session.awaitingAck.pop_front();
+}
+
+void ROS2Bridge::dropOutbound(Session &session)
+{
+  std::deque<ros2_android_vhal__srv__GetVehicleProperty_Request> outboundGets;
+  {
+    std::lock_guard<std::mutex> lock(session.outboundLock);
+    m_setSendFailures += session.outbound.size();
+    session.outbound.clear();
+    outboundGets.swap(session.outboundGets);
+  }
+  // Answers to these went down with the session, and so did the rest of any partial transfer.
+  if (session.transfer) {
+    m_setSendFailures++;
+    session.transfer.reset();
+  }
+  session.awaitingAck.clear();
+  session.fragmentsInFlight = 0;
+  session.assembler.clear();
+
+  // Readers are waiting on these, answer them instead of letting them time out.
+  for (auto &req : outboundGets) {
+    if (m_onGetResponse) {
+      m_onGetResponse(req.prop_id, req.area_id, std::nullopt);
+    }
+    ros2_android_vhal__srv__GetVehicleProperty_Request__fini(&req);
+  }
+}
+
+void ROS2Bridge::syncClock(Session &session)
+{
+  const auto agentNs = session.transport->syncClock();
+  if (!agentNs) {
+    return;
+  }
+
+  const bool wasSynced = session.clock.synced();
+  session.clock.update(*agentNs, android::elapsedRealtimeNano());
+  if (!wasSynced) {
+    ALOGI("ROS2Bridge - session clock synced, offset %lld ns",
+          static_cast<long long>(session.clock.state().offsetNs));
+  }
+}
+
+aidl::android::hardware::automotive::vehicle::VehiclePropValue ROS2Bridge::toLocalTime(
+    Session &session, aidl::android::hardware::automotive::vehicle::VehiclePropValue value, bool sample)
+{
+  const int64_t now = android::elapsedRealtimeNano();
+  if (!session.clock.synced()) {
+    // A timestamp of a foreign clock would confuse every subscriber, the arrival time is closer.
+    value.timestamp = now;
+    return value;
+  }
+
+  value.timestamp = session.clock.toLocal(value.timestamp);
+  if (sample) {
+    m_inboundLatency.record(now - value.timestamp);
+  }
+  // The estimate can land slightly ahead of now, VHAL timestamps must not be in the future.
+  value.timestamp = std::min(value.timestamp, now);
+  return value;
+}
+
+void ROS2Bridge::handleVehicleProperty(size_t session, const ros2_android_vhal__msg__VehicleProperty &msg)
+{
+  m_samplesReceived++;
+  if (!m_onPropertyUpdate) {
+    return;
+  }
+
+  Session &owner = *m_sessions[session];
+  if (isZonedBatch(msg)) {
+    auto values = decodeZonedBatch(msg);
+    if (values.empty()) {
+      ALOGW("ROS2Bridge - malformed zoned batch of property %d", msg.prop_id);
+      return;
+    }
+    m_zonedBatchesReceived++;
+    for (auto &value : values) {
+      // The areas share one timestamp, its latency is recorded once.
+      value = toLocalTime(owner, std::move(value), &value == &values.front());
+    }
+
+    if (m_onPropertyBatch) {
+      m_onPropertyBatch(std::move(values));
+    }
+    else {
+      for (auto &value : values) {
+        m_onPropertyUpdate(std::move(value));
+      }
+    }
+    return;
+  }
+
+  if (isFragment(msg)) {
+    auto value = owner.assembler.add(msg, android::elapsedRealtimeNano());
+    if (value) {
+      m_transfersReceived++;
+      m_onPropertyUpdate(toLocalTime(owner, std::move(*value), true));
+    }
+    return;
+  }
+
+  m_onPropertyUpdate(toLocalTime(owner, decodeProperty(msg), true));
+}
+
+void ROS2Bridge::handleSetResponse(size_t session, const ros2_android_vhal__srv__SetVehicleProperty_Response &response)
+{
+  auto &owner = *m_sessions[session];
+  if (!owner.awaitingAck.empty()) {
+    m_setRoundTrip.record(android::elapsedRealtimeNano() - owner.awaitingAck.front().sentAt);
+    popAck(owner);
+  }
+
+  if (response.result == Transport::kResultOk) {
+    m_setsAcked++;
   }
   else {
-    ALOGD("rcl_send_request setProperty(%d) sent", propId);
+    m_setsRejected++;
   }
+  ALOGD("set_vehicle_property_callback result: %d", response.result);
+}
 
-  return true;
+void ROS2Bridge::handleGetResponse(size_t session, const ros2_android_vhal__srv__GetVehicleProperty_Response &response)
+{
+  m_getsAnswered++;
+  if (!m_onGetResponse) {
+    return;
+  }
+
+  if (response.result == Transport::kResultOk) {
+    m_onGetResponse(response.prop.prop_id, response.prop.area_id,
+                    toLocalTime(*m_sessions[session], decodeProperty(response.prop), false));
+  }
+  else {
+    m_onGetResponse(response.prop.prop_id, response.prop.area_id, std::nullopt);
+  }
 }
 
 void ROS2Bridge::start(std::chrono::seconds timeout)
 {
-  m_thread = std::thread([this, timeout]() {
-    std::this_thread::sleep_for(timeout);
+  for (auto &session : m_sessions) {
+    session->lastHeartbeatNs = android::elapsedRealtimeNano();
+    session->thread = std::thread([this, &session = *session, timeout]() { runSession(session, timeout); });
+  }
+}
 
-    while (m_running) {
-      switch (m_AgentState) {
-        case AgentConnectionState::DISCONNECTED:
-          m_rmw_options = rcl_init_options_get_rmw_init_options(&m_init_options);
-          ALOGD("ROS2Bridge - discovery agent");
-          if (rmw_uros_discover_agent(m_rmw_options) == RMW_RET_OK) {
-            ALOGD("ROS2Bridge - agent discovered");
-          }
-          else {
-            m_rmw_options = nullptr;
-          }
+void ROS2Bridge::runSession(Session &session, std::chrono::seconds timeout)
+{
+  Transport &transport = *session.transport;
+  {
+    std::unique_lock<std::mutex> lock(m_stateMutex);
+    m_stopCv.wait_for(lock, timeout, [this]() { return !m_running; });
+  }
 
-          if (pingAgent()) {
-            ALOGD("ROS2Bridge - agent found");
-            createEntities();
-            m_AgentState = AgentConnectionState::CONNECTED;
-          }
-          else {
-            ALOGD("ROS2Bridge - agent not found");
-          }
-          break;
-        case AgentConnectionState::CONNECTED:
-          if (!pingAgent()) {
+  auto nextPing = std::chrono::steady_clock::now();
+  auto nextClockSync = nextPing;
+
+  while (m_running) {
+    // Every iteration is bounded by the ping interval or the agent timeouts, a stale heartbeat
+    // means the loop is stuck.
+    session.heartbeats++;
+    session.lastHeartbeatNs = android::elapsedRealtimeNano();
+
+    switch (session.state) {
+      case AgentConnectionState::DISCONNECTED:
+        ALOGD("ROS2Bridge - discovery agent");
+        if (transport.discoverAgent()) {
+          ALOGD("ROS2Bridge - agent discovered");
+        }
+
+        if (transport.pingAgent()) {
+          ALOGD("ROS2Bridge - agent found");
+          // Anything queued while the session was down is stale by now.
+          dropOutbound(session);
+          transport.createEntities();
+          session.state = AgentConnectionState::CONNECTED;
+          m_connects++;
+          nextPing = std::chrono::steady_clock::now() + kPingInterval;
+          // The agent may have restarted with another clock, start over from a fresh offset.
+          session.clock.reset();
+          nextClockSync = std::chrono::steady_clock::now();
+        }
+        else {
+          ALOGD("ROS2Bridge - agent not found");
+        }
+        break;
+      case AgentConnectionState::CONNECTED: {
+        const auto now = std::chrono::steady_clock::now();
+        if (now >= nextPing) {
+          if (!transport.pingAgent()) {
             ALOGD("ROS2Bridge - agent lost");
-            destroyEntities();
-            m_AgentState = AgentConnectionState::DISCONNECTED;
+            session.state = AgentConnectionState::DISCONNECTED;
+            m_disconnects++;
+            dropOutbound(session);
+            transport.destroyEntities();
+            break;
           }
-          else {
-            RCSOFTCHECK(rclc_executor_spin_some(&m_executor, RCL_MS_TO_NS(100)));
-          }
-          break;
+          nextPing = std::chrono::steady_clock::now() + kPingInterval;
+        }
+        if (now >= nextClockSync) {
+          syncClock(session);
+          nextClockSync = std::chrono::steady_clock::now() + kClockSyncInterval;
+        }
+
+        flushOutbound(session);
+        transport.spin(std::max<std::chrono::nanoseconds>(nextPing - std::chrono::steady_clock::now(),
+                                                          std::chrono::nanoseconds::zero()));
+        flushOutbound(session);
+        break;
       }
     }
+  }
 
-    destroyEntities();
-    ALOGD("ROS2Bridge - Thread stopped");
-  });
+  if (session.state == AgentConnectionState::CONNECTED) {
+    session.state = AgentConnectionState::DISCONNECTED;
+    dropOutbound(session);
+    transport.destroyEntities();
+  }
+  ALOGD("ROS2Bridge - Thread stopped");
 }
 
 }  // namespace vendor::spyrosoft::vehicle::ros2
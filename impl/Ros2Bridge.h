@@ -22,59 +22,220 @@
 
 #pragma once
 
-#include <rcl/rcl.h>
-#include <rclc/rclc.h>
-#include <rclc/executor.h>
-#include <ros2_android_vhal/msg/vehicle_property.h>
-#include <ros2_android_vhal/srv/set_vehicle_property.h>
+#include <aidl/android/hardware/automotive/vehicle/VehiclePropValue.h>
 
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
 #include <mutex>
+#include <optional>
 #include <string>
 #include <thread>
-#include <variant>
+#include <vector>
+
+#include "Ros2ClockSync.h"
+#include "Ros2LatencyHistogram.h"
+#include "Ros2PropertyFragments.h"
+#include "Ros2Transport.h"
 
 namespace vendor::spyrosoft::vehicle::ros2 {
 
 enum class AgentConnectionState { CONNECTED, DISCONNECTED };
 
+struct SessionHealth {
+  bool connected = false;
+  // Iterations of the session loop, and elapsedRealtimeNano() of the latest one.
+  uint64_t heartbeats = 0;
+  int64_t lastHeartbeatNs = 0;
+};
+
+struct BridgeStats {
+  uint64_t connects = 0;
+  uint64_t disconnects = 0;
+  uint64_t setsSent = 0;
+  uint64_t setSendFailures = 0;
+  uint64_t setsAcked = 0;
+  uint64_t setsRejected = 0;
+  uint64_t samplesReceived = 0;
+  uint64_t getsSent = 0;
+  uint64_t getsAnswered = 0;
+  // Fragments of large STRING and BYTES values, see Ros2PropertyFragments.h.
+  uint64_t fragmentsSent = 0;
+  uint64_t transfersReceived = 0;
+  uint64_t transfersDropped = 0;
+  // Zoned batches, see Ros2PropertyCodec.h.
+  uint64_t zonedBatchesSent = 0;
+  uint64_t zonedBatchesReceived = 0;
+
+  // Vehicle timestamp to arrival, needs a synced session clock.
+  LatencyHistogram::Summary inboundLatency;
+  // setProperty() to the request leaving on its session.
+  LatencyHistogram::Summary outboundQueueing;
+  // Request sent to the vehicle's answer.
+  LatencyHistogram::Summary setRoundTrip;
+  // Clock and loop progress of every session, in session order.
+  std::vector<ClockSync::State> clocks;
+  std::vector<SessionHealth> sessions;
+};
+
 /**
- * @brief
+ * @brief Connects the VHAL with the vehicle over one or more Transport sessions, keeps them alive
+ * and translates between VHAL property values and ROS messages.
  *
+ * Every session runs its own connection loop and executor on a dedicated thread, so losing one
+ * agent does not stall the traffic of the other sessions.
  */
 class ROS2Bridge {
   public:
-  using PropertyValue_t = std::variant<int64_t, int32_t, uint8_t, float, std::string>;
+  using PropertyUpdateCallback = std::function<void(aidl::android::hardware::automotive::vehicle::VehiclePropValue)>;
+  // All areas of a zoned batch at once.
+  using PropertyBatchCallback =
+      std::function<void(std::vector<aidl::android::hardware::automotive::vehicle::VehiclePropValue>)>;
+  // Answer to getProperty(), no value when the vehicle could not serve the request.
+  using GetResponseCallback =
+      std::function<void(int32_t propId, int32_t areaId,
+                         std::optional<aidl::android::hardware::automotive::vehicle::VehiclePropValue> value)>;
+  // Picks the session a property is exchanged on, as an index into the bridge's transports.
+  using SessionRouter = std::function<size_t(int32_t propId)>;
 
  public:
-  ROS2Bridge();
+  explicit ROS2Bridge(std::unique_ptr<Transport> transport);
+  ROS2Bridge(std::vector<std::unique_ptr<Transport>> transports, SessionRouter router);
   virtual ~ROS2Bridge();
 
-  void start(std::chrono::seconds timeout = std::chrono::seconds(0));
-  void stop() { m_running = false; }
-  bool is_connected() const { return (m_AgentState == AgentConnectionState::CONNECTED); }
+  // Starts the agent discovery/connection loop on a dedicated thread. The call returns immediately,
+  // the optional delay is applied on the bridge thread and is interrupted by stop().
+  virtual void start(std::chrono::seconds timeout = std::chrono::seconds(0));
+  // Stops and joins the session threads, no callback runs once it returns. Must not be called from
+  // a callback.
+  virtual void stop();
+  // Whether at least one session is connected.
+  virtual bool is_connected() const;
+
+  // Queues the value on the session the property is routed to and wakes its thread, which encodes
+  // and sends it. Fails when that session is down or the value does not match its type.
+  virtual bool setProperty(const aidl::android::hardware::automotive::vehicle::VehiclePropValue& value);
+
+  // Queues several values with a single wakeup per session. Queued areas of one zoned property
+  // are sent as a single zoned batch. Fails when any of the values could not be queued.
+  virtual bool setProperties(std::vector<aidl::android::hardware::automotive::vehicle::VehiclePropValue> values);
+
+  // Queues a read of the current value from the vehicle, the answer is delivered to the get
+  // response callback. Fails when the routed session is down.
+  virtual bool getProperty(int32_t propId, int32_t areaId);
+
+  // Register a callback called on the bridge thread for every property sample published by the vehicle.
+  void setOnPropertyUpdate(PropertyUpdateCallback callback);
+
+  // Register a callback called on the bridge thread for every zoned batch published by the
+  // vehicle. Without one, the areas of a batch are passed to the property update callback one by one.
+  void setOnPropertyBatch(PropertyBatchCallback callback);
+
+  // Register a callback called on the bridge thread with the answers to getProperty().
+  void setOnGetResponse(GetResponseCallback callback);
 
-  bool setProperty(int64_t timestamp, int32_t areaId, int32_t propId, PropertyValue_t value);
+  BridgeStats stats() const;
 
  protected:
-  void createEntities();
-  void destroyEntities();
-  bool pingAgent();
+  // Decodes an inbound sample of the given session and hands it to the registered callback.
+  void handleVehicleProperty(size_t session, const ros2_android_vhal__msg__VehicleProperty& msg);
+  void handleSetResponse(size_t session, const ros2_android_vhal__srv__SetVehicleProperty_Response& response);
+  void handleGetResponse(size_t session, const ros2_android_vhal__srv__GetVehicleProperty_Response& response);
+
+  PropertyUpdateCallback m_onPropertyUpdate;
+  PropertyBatchCallback m_onPropertyBatch;
+  GetResponseCallback m_onGetResponse;
 
  private:
-  std::thread m_thread;
+  struct OutboundSet {
+    // Shared so fragments can borrow their payload from it while they are sent.
+    std::shared_ptr<const aidl::android::hardware::automotive::vehicle::VehiclePropValue> value;
+    // elapsedRealtimeNano() of the setProperty() call.
+    int64_t queuedAt;
+  };
+
+  struct PendingAck {
+    int64_t sentAt;
+    bool fragment;
+  };
+
+  struct OutboundTransfer {
+    std::shared_ptr<const aidl::android::hardware::automotive::vehicle::VehiclePropValue> value;
+    int64_t id;
+    // Payload bytes sent so far.
+    size_t offset;
+  };
+
+  struct Session {
+    std::unique_ptr<Transport> transport;
+    std::thread thread;
+    std::atomic<AgentConnectionState> state = AgentConnectionState::DISCONNECTED;
+    ClockSync clock;
+    std::atomic_uint64_t heartbeats{0};
+    std::atomic_int64_t lastHeartbeatNs{0};
+    // Inbound fragments, session thread only.
+    FragmentAssembler assembler;
+
+    std::mutex outboundLock;
+    std::deque<OutboundSet> outbound;
+    std::deque<ros2_android_vhal__srv__GetVehicleProperty_Request> outboundGets;
+
+    // Sets awaiting an answer, the service answers in order. Session thread only.
+    std::deque<PendingAck> awaitingAck;
+    size_t fragmentsInFlight = 0;
+    // Large value being sent in fragments, session thread only.
+    std::optional<OutboundTransfer> transfer;
+  };
+
+  // Session a property is routed to, nullptr when that session is down.
+  Session* connectedSession(int32_t propId);
+
+  void runSession(Session& session, std::chrono::seconds timeout);
+  // Sends the queued requests, on the session thread.
+  void flushOutbound(Session& session);
+  // Sends the next fragments of the transfer in progress, at most kMaxFragmentsInFlight unanswered.
+  // Returns false while fragments remain.
+  bool continueTransfer(Session& session);
+  void awaitAck(Session& session, int64_t sentAt, bool fragment);
+  // Forgets the sets unanswered for longer than kAckTimeoutNs.
+  void expireAcks(Session& session, int64_t now);
+  void popAck(Session& session);
+  void dropOutbound(Session& session);
+  // Pairs the agent clock with the local one, on the session thread.
+  void syncClock(Session& session);
+
+  // Inbound timestamp in the elapsedRealtimeNano() domain, the arrival time when unsynced.
+  aidl::android::hardware::automotive::vehicle::VehiclePropValue toLocalTime(
+      Session& session, aidl::android::hardware::automotive::vehicle::VehiclePropValue value, bool sample);
+
+  std::vector<std::unique_ptr<Session>> m_sessions;
+  const SessionRouter m_router;
+
   std::atomic_bool m_running{true};
-  std::atomic<AgentConnectionState> m_AgentState = AgentConnectionState::DISCONNECTED;
+  std::mutex m_stateMutex;
+  std::condition_variable m_stopCv;
 
-  rcl_init_options_t m_init_options;
-  rmw_init_options_t* m_rmw_options = nullptr;
-  rclc_support_t m_support;
-  rcl_allocator_t m_allocator;
-  rcl_node_t m_node;
-  rclc_executor_t m_executor;
+  std::atomic_uint64_t m_connects{0};
+  std::atomic_uint64_t m_disconnects{0};
+  std::atomic_uint64_t m_setsSent{0};
+  std::atomic_uint64_t m_setSendFailures{0};
+  std::atomic_uint64_t m_setsAcked{0};
+  std::atomic_uint64_t m_setsRejected{0};
+  std::atomic_uint64_t m_samplesReceived{0};
+  std::atomic_uint64_t m_getsSent{0};
+  std::atomic_uint64_t m_getsAnswered{0};
+  std::atomic_uint64_t m_fragmentsSent{0};
+  std::atomic_uint64_t m_transfersReceived{0};
+  std::atomic_uint64_t m_zonedBatchesSent{0};
+  std::atomic_uint64_t m_zonedBatchesReceived{0};
+  std::atomic_int64_t m_nextTransferId{0};
 
-  rcl_client_t m_vehiclePropertyClient;
-  std::mutex m_clientMutex;
+  LatencyHistogram m_inboundLatency;
+  LatencyHistogram m_outboundQueueing;
+  LatencyHistogram m_setRoundTrip;
 };
 
 }  // namespace vendor::spyrosoft::vehicle::ros2
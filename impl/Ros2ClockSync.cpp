@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2023 Spyrosoft Synergy S.A.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "Ros2ClockSync.h"
+
+namespace vendor::spyrosoft::vehicle::ros2 {
+
+namespace {
+
+// Weight of the newest drift measurement, smooths out the jitter of a single sync round trip.
+constexpr double kDriftSmoothing = 0.2;
+
+}  // namespace
+
+void ClockSync::update(int64_t agentNs, int64_t localNs)
+{
+  std::lock_guard<std::mutex> lock(m_lock);
+  const int64_t offset = agentNs - localNs;
+
+  if (m_state.synced && localNs > m_lastLocalNs) {
+    const double drift = static_cast<double>(offset - m_state.offsetNs) / static_cast<double>(localNs - m_lastLocalNs);
+    m_drift = (m_state.syncs > 1) ? (1.0 - kDriftSmoothing) * m_drift + kDriftSmoothing * drift : drift;
+  }
+
+  m_state.synced = true;
+  m_state.offsetNs = offset;
+  m_state.driftPpm = m_drift * 1e6;
+  m_state.syncs++;
+  m_lastLocalNs = localNs;
+}
+
+void ClockSync::reset()
+{
+  std::lock_guard<std::mutex> lock(m_lock);
+  m_state = State{};
+  m_lastLocalNs = 0;
+  m_drift = 0.0;
+}
+
+bool ClockSync::synced() const
+{
+  std::lock_guard<std::mutex> lock(m_lock);
+  return m_state.synced;
+}
+
+int64_t ClockSync::toLocal(int64_t agentNs) const
+{
+  std::lock_guard<std::mutex> lock(m_lock);
+  if (!m_state.synced) {
+    return agentNs;
+  }
+
+  // The offset keeps drifting after the last sync, estimate it at the sample's local time.
+  const int64_t localGuess = agentNs - m_state.offsetNs;
+  const double drifted = m_drift * static_cast<double>(localGuess - m_lastLocalNs);
+  return localGuess - static_cast<int64_t>(drifted);
+}
+
+ClockSync::State ClockSync::state() const
+{
+  std::lock_guard<std::mutex> lock(m_lock);
+  return m_state;
+}
+
+}  // namespace vendor::spyrosoft::vehicle::ros2
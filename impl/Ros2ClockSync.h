@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2023 Spyrosoft Synergy S.A.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+
+namespace vendor::spyrosoft::vehicle::ros2 {
+
+/**
+ * @brief Maps agent (vehicle) timestamps into the elapsedRealtimeNano() domain.
+ *
+ * Each sync pairs an agent epoch time with the local time it was taken at. The offset between
+ * both clocks is tracked together with its drift, so translations stay accurate between syncs.
+ */
+class ClockSync {
+ public:
+  struct State {
+    bool synced = false;
+    int64_t offsetNs = 0;
+    double driftPpm = 0.0;
+    uint64_t syncs = 0;
+  };
+
+  // Agent epoch time in ns observed at local time localNs.
+  void update(int64_t agentNs, int64_t localNs);
+  void reset();
+
+  bool synced() const;
+
+  // Agent timestamp to elapsedRealtimeNano() domain, the value is returned as-is until synced.
+  int64_t toLocal(int64_t agentNs) const;
+
+  State state() const;
+
+ private:
+  mutable std::mutex m_lock;
+  State m_state;
+  int64_t m_lastLocalNs = 0;
+  // Offset change per local ns.
+  double m_drift = 0.0;
+};
+
+}  // namespace vendor::spyrosoft::vehicle::ros2
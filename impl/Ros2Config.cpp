@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2023 Spyrosoft Synergy S.A.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "Ros2Config.h"
+
+#include <android-base/properties.h>
+#include <android-base/strings.h>
+
+#include <cstdlib>
+
+#include "common/logging.hpp"
+
+namespace vendor::spyrosoft::vehicle {
+
+namespace {
+
+// Fetches are expired every half timeout, a shorter one would only busy the timer thread.
+constexpr std::chrono::milliseconds kMinReadThroughTimeout{20};
+
+}  // namespace
+
+Config loadConfig()
+{
+  using android::base::GetProperty;
+  using android::base::GetUintProperty;
+
+  Config config;
+  config.snapshotPath = GetProperty("debug.ros2vhal.snapshot_path", config.snapshotPath);
+  config.snapshotInterval = std::chrono::milliseconds(
+      GetUintProperty<uint64_t>("debug.ros2vhal.snapshot_interval_ms", config.snapshotInterval.count()));
+  config.recordPath = GetProperty("debug.ros2vhal.record_path", config.recordPath);
+
+  for (const auto& name : android::base::Split(GetProperty("debug.ros2vhal.sessions", ""), ",")) {
+    if (name.empty()) {
+      continue;
+    }
+    if (auto domain = parsePropertyDomain(android::base::Trim(name)); domain.has_value()) {
+      config.sessionDomains.push_back(*domain);
+    }
+    else {
+      ALOGW("Config: unknown session domain %s", name.c_str());
+    }
+  }
+
+  config.agentAddresses["default"] = GetProperty("debug.ros2vhal.agent.default", "");
+  for (const auto domain : config.sessionDomains) {
+    config.agentAddresses[toString(domain)] = GetProperty(std::string("debug.ros2vhal.agent.") + toString(domain), "");
+  }
+
+  ALOGI("Config: snapshot %s every %lld ms", config.snapshotPath.c_str(),
+        static_cast<long long>(config.snapshotInterval.count()));
+  // "<propId>:<ttl ms>,..." with the property id in decimal or 0x-prefixed hex.
+  for (const auto& entry : android::base::Split(GetProperty("debug.ros2vhal.read_through", ""), ",")) {
+    const auto fields = android::base::Split(android::base::Trim(entry), ":");
+    if (fields.size() != 2) {
+      if (!entry.empty()) {
+        ALOGW("Config: malformed read-through entry %s", entry.c_str());
+      }
+      continue;
+    }
+    const auto propId = static_cast<int32_t>(std::strtoul(fields[0].c_str(), nullptr, 0));
+    config.readThroughTtl[propId] = std::chrono::milliseconds(std::strtoul(fields[1].c_str(), nullptr, 10));
+  }
+  config.readThroughTimeout = std::chrono::milliseconds(
+      GetUintProperty<uint64_t>("debug.ros2vhal.read_through_timeout_ms", config.readThroughTimeout.count()));
+  if (config.readThroughTimeout.count() == 0 && !config.readThroughTtl.empty()) {
+    // Every fetch would time out before it was sent.
+    ALOGW("Config: read-through timeout is 0, read-through disabled");
+    config.readThroughTtl.clear();
+  }
+  else if (config.readThroughTimeout < kMinReadThroughTimeout) {
+    config.readThroughTimeout = kMinReadThroughTimeout;
+  }
+
+  config.allocatorPoolSize =
+      GetUintProperty<size_t>("debug.ros2vhal.pool_size_kb", config.allocatorPoolSize / 1024) * 1024;
+
+  config.stallTimeout = std::chrono::milliseconds(
+      GetUintProperty<uint64_t>("debug.ros2vhal.stall_timeout_ms", config.stallTimeout.count()));
+  config.queueLatencySlo = std::chrono::milliseconds(
+      GetUintProperty<uint64_t>("debug.ros2vhal.queue_latency_slo_ms", config.queueLatencySlo.count()));
+  config.degradedRecovery = std::chrono::milliseconds(
+      GetUintProperty<uint64_t>("debug.ros2vhal.degraded_recovery_ms", config.degradedRecovery.count()));
+  config.degradedMode = android::base::GetBoolProperty("debug.ros2vhal.degraded_mode", config.degradedMode);
+  if (const auto lowPriority = GetProperty("debug.ros2vhal.low_priority", ""); !lowPriority.empty()) {
+    config.lowPriorityDomains.clear();
+    for (const auto& name : android::base::Split(lowPriority, ",")) {
+      if (auto domain = parsePropertyDomain(android::base::Trim(name)); domain.has_value()) {
+        config.lowPriorityDomains.push_back(*domain);
+      }
+      else {
+        ALOGW("Config: unknown low-priority domain %s", name.c_str());
+      }
+    }
+  }
+
+  ALOGI("Config: %zu dedicated sessions, %zu read-through properties", config.sessionDomains.size(),
+        config.readThroughTtl.size());
+  if (!config.recordPath.empty()) {
+    ALOGI("Config: recording traffic to %s", config.recordPath.c_str());
+  }
+  return config;
+}
+
+}  // namespace vendor::spyrosoft::vehicle
@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2023 Spyrosoft Synergy S.A.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Ros2PropertyDomain.h"
+
+namespace vendor::spyrosoft::vehicle {
+
+/**
+ * @brief Runtime configuration of the service, read from "debug.ros2vhal.*" system properties.
+ *
+ */
+struct Config {
+  // Warm-restart snapshot of the on-change and static properties, empty path disables it. Rewritten
+  // at most this often and only when one of them changed, and once more on shutdown.
+  std::string snapshotPath = "/data/vendor/ros2vhal/store.snapshot";
+  std::chrono::milliseconds snapshotInterval = std::chrono::seconds(60);
+
+  // Capture of VHAL requests and ROS traffic for replay, empty path disables it.
+  std::string recordPath;
+
+  // Domains that get a dedicated micro-ROS session, all other properties share the default one.
+  std::vector<PropertyDomain> sessionDomains;
+  // Static agent "ip:port" per session ("default" or a domain name), others discover their agent.
+  std::map<std::string, std::string> agentAddresses;
+
+  // Vehicle-owned properties read through from the vehicle, with the time a fetched value stays fresh.
+  std::map<int32_t, std::chrono::milliseconds> readThroughTtl;
+  // Readers are answered from the store when the vehicle does not respond within this time.
+  std::chrono::milliseconds readThroughTimeout = std::chrono::milliseconds(500);
+
+  // Arena of the micro-ROS allocator, reserved at startup. Zero leaves micro-ROS on the system heap.
+  size_t allocatorPoolSize = 512 * 1024;
+
+  // A worker or session loop without progress for this long makes the service unhealthy.
+  std::chrono::milliseconds stallTimeout = std::chrono::seconds(10);
+  // Requests waiting longer than this for a worker put the service into degraded mode.
+  std::chrono::milliseconds queueLatencySlo = std::chrono::milliseconds(200);
+  // Degraded mode ends once the SLO has been met for this long.
+  std::chrono::milliseconds degradedRecovery = std::chrono::seconds(3);
+  // While degraded, queued requests of the low-priority domains are shed, vehicle samples never are.
+  // Disabled, degradation is only reported.
+  bool degradedMode = false;
+  std::vector<PropertyDomain> lowPriorityDomains = {PropertyDomain::OTHER};
+};
+
+Config loadConfig();
+
+}  // namespace vendor::spyrosoft::vehicle
@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2023 Spyrosoft Synergy S.A.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "Ros2LatencyHistogram.h"
+
+#include <android-base/stringprintf.h>
+
+namespace vendor::spyrosoft::vehicle::ros2 {
+
+namespace {
+
+size_t bucketOf(uint64_t nanos)
+{
+  size_t bucket = 0;
+  while (nanos > 1 && bucket < 47) {
+    nanos >>= 1;
+    bucket++;
+  }
+  return bucket;
+}
+
+}  // namespace
+
+void LatencyHistogram::record(int64_t nanos)
+{
+  // Clock adjustments can produce small negative latencies, count them as zero.
+  const uint64_t value = nanos > 0 ? static_cast<uint64_t>(nanos) : 0;
+
+  m_buckets[bucketOf(value)].fetch_add(1, std::memory_order_relaxed);
+  m_count.fetch_add(1, std::memory_order_relaxed);
+  m_sumNs.fetch_add(value, std::memory_order_relaxed);
+
+  int64_t max = m_maxNs.load(std::memory_order_relaxed);
+  while (static_cast<int64_t>(value) > max &&
+         !m_maxNs.compare_exchange_weak(max, static_cast<int64_t>(value), std::memory_order_relaxed)) {
+  }
+}
+
+LatencyHistogram::Summary LatencyHistogram::summary() const
+{
+  Summary summary;
+  summary.count = m_count.load(std::memory_order_relaxed);
+  summary.maxNs = m_maxNs.load(std::memory_order_relaxed);
+  if (summary.count == 0) {
+    return summary;
+  }
+  summary.meanNs = static_cast<int64_t>(m_sumNs.load(std::memory_order_relaxed) / summary.count);
+
+  const uint64_t p50Rank = (summary.count + 1) / 2;
+  const uint64_t p99Rank = (summary.count * 99 + 99) / 100;
+  uint64_t seen = 0;
+  for (size_t i = 0; i < kBuckets; i++) {
+    const uint64_t inBucket = m_buckets[i].load(std::memory_order_relaxed);
+    const int64_t upperBound = int64_t{1} << (i + 1);
+    if (seen < p50Rank && seen + inBucket >= p50Rank) {
+      summary.p50Ns = upperBound;
+    }
+    if (seen < p99Rank && seen + inBucket >= p99Rank) {
+      summary.p99Ns = upperBound;
+    }
+    seen += inBucket;
+  }
+  return summary;
+}
+
+std::string LatencyHistogram::Summary::toString() const
+{
+  return android::base::StringPrintf("count %llu, mean %lld us, p50 <%lld us, p99 <%lld us, max %lld us",
+                                     static_cast<unsigned long long>(count), static_cast<long long>(meanNs / 1000),
+                                     static_cast<long long>(p50Ns / 1000), static_cast<long long>(p99Ns / 1000),
+                                     static_cast<long long>(maxNs / 1000));
+}
+
+}  // namespace vendor::spyrosoft::vehicle::ros2
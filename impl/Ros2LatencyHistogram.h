@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2023 Spyrosoft Synergy S.A.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace vendor::spyrosoft::vehicle::ros2 {
+
+/**
+ * @brief Lock-free latency histogram with power-of-two buckets.
+ *
+ * Percentiles are reported as the upper bound of the bucket they fall in, good enough to tell
+ * microseconds from milliseconds without any cost on the recording path.
+ */
+class LatencyHistogram {
+ public:
+  struct Summary {
+    uint64_t count = 0;
+    int64_t meanNs = 0;
+    int64_t p50Ns = 0;
+    int64_t p99Ns = 0;
+    int64_t maxNs = 0;
+
+    std::string toString() const;
+  };
+
+  void record(int64_t nanos);
+
+  Summary summary() const;
+
+ private:
+  static constexpr size_t kBuckets = 48;
+
+  std::array<std::atomic_uint64_t, kBuckets> m_buckets{};
+  std::atomic_uint64_t m_count{0};
+  std::atomic_uint64_t m_sumNs{0};
+  std::atomic_int64_t m_maxNs{0};
+};
+
+}  // namespace vendor::spyrosoft::vehicle::ros2
@@ -0,0 +1,363 @@
+/*
+ * Copyright (c) 2023 Spyrosoft Synergy S.A.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "Ros2LoopbackTransport.h"
+
+#include <VehicleUtils.h>
+#include <utils/SystemClock.h>
+
+#include <cmath>
+#include <optional>
+#include <string>
+#include <thread>
+
+#include "Ros2PropertyCodec.h"
+#include "common/logging.hpp"
+
+namespace vendor::spyrosoft::vehicle::ros2 {
+
+using aidl::android::hardware::automotive::vehicle::VehiclePropertyType;
+
+namespace {
+
+// A ping of an unreachable agent costs what MicroRosTransport::pingAgent() waits for its answers.
+constexpr std::chrono::milliseconds kPingTimeout{250};
+constexpr int kPingAttempts = 5;
+
+// Backing storage of a synthetic sample, the message sequences borrow it and are never fini'd.
+struct SyntheticValue {
+  float floatValue;
+  int32_t int32Value;
+  int64_t int64Value;
+};
+
+ros2_android_vhal__msg__VehicleProperty make_synthetic_sample(int32_t propId, int32_t areaId, uint64_t counter,
+                                                              int64_t clockOffsetNs, SyntheticValue& storage)
+{
+  storage.floatValue = static_cast<float>(50.0 + 50.0 * std::sin(static_cast<double>(counter) / 10.0));
+  storage.int32Value = static_cast<int32_t>(counter);
+  storage.int64Value = static_cast<int64_t>(counter);
+
+  ros2_android_vhal__msg__VehicleProperty msg = {};
+  msg.timestamp = android::elapsedRealtimeNano() + clockOffsetNs;
+  msg.area_id = areaId;
+  msg.prop_id = propId;
+
+  switch (android::hardware::automotive::vehicle::getPropType(propId)) {
+    case VehiclePropertyType::FLOAT:
+      msg.float_values = {&storage.floatValue, 1, 1};
+      break;
+    case VehiclePropertyType::INT64:
+      msg.int64_values = {&storage.int64Value, 1, 1};
+      break;
+    default:
+      msg.int32_values = {&storage.int32Value, 1, 1};
+      break;
+  }
+  return msg;
+}
+
+}  // namespace
+
+struct LoopbackTransport::Echo {
+  int32_t propId;
+  int32_t areaId;
+  std::vector<int64_t> int64Values;
+  std::vector<int32_t> int32Values;
+  std::vector<uint8_t> byteValues;
+  std::vector<float> floatValues;
+  std::optional<std::string> stringValue;
+
+  explicit Echo(const ros2_android_vhal__msg__VehicleProperty& msg)
+      : propId(msg.prop_id),
+        areaId(msg.area_id),
+        int64Values(msg.int64_values.data, msg.int64_values.data + msg.int64_values.size),
+        int32Values(msg.int32_values.data, msg.int32_values.data + msg.int32_values.size),
+        byteValues(msg.uint8_values.data, msg.uint8_values.data + msg.uint8_values.size),
+        floatValues(msg.float_values.data, msg.float_values.data + msg.float_values.size)
+  {
+    if (msg.string_values.size > 0) {
+      stringValue.emplace(msg.string_values.data[0].data, msg.string_values.data[0].size);
+    }
+  }
+
+  // The message borrows the copy, as the synthetic samples do. string is its backing storage.
+  ros2_android_vhal__msg__VehicleProperty msg(int64_t timestamp, rosidl_runtime_c__String& string) const
+  {
+    ros2_android_vhal__msg__VehicleProperty msg = {};
+    msg.timestamp = timestamp;
+    msg.area_id = areaId;
+    msg.prop_id = propId;
+    msg.int64_values = {const_cast<int64_t*>(int64Values.data()), int64Values.size(), int64Values.size()};
+    msg.int32_values = {const_cast<int32_t*>(int32Values.data()), int32Values.size(), int32Values.size()};
+    msg.uint8_values = {const_cast<uint8_t*>(byteValues.data()), byteValues.size(), byteValues.size()};
+    msg.float_values = {const_cast<float*>(floatValues.data()), floatValues.size(), floatValues.size()};
+    if (stringValue) {
+      string = {const_cast<char*>(stringValue->c_str()), stringValue->size(), stringValue->size() + 1};
+      msg.string_values = {&string, 1, 1};
+    }
+    return msg;
+  }
+};
+
+LoopbackTransport::LoopbackTransport(Options options)
+    : m_options(std::move(options)), m_random(m_options.seed), m_nextSample(Clock::now())
+{
+  ALOGI("LoopbackTransport - latency %lld us, loss %.3f, ack failure %.3f, agent drop %.3f, %zu signals at %u Hz",
+        static_cast<long long>(m_options.latency.count()), m_options.lossRate, m_options.ackFailureRate,
+        m_options.agentDropRate, m_options.syntheticPropIds.size(), m_options.syntheticRateHz);
+}
+
+bool LoopbackTransport::chance(double probability)
+{
+  return probability > 0.0 && std::uniform_real_distribution<double>(0.0, 1.0)(m_random) < probability;
+}
+
+bool LoopbackTransport::discoverAgent()
+{
+  std::lock_guard<std::mutex> lock(m_lock);
+  return agentReachable(Clock::now());
+}
+
+bool LoopbackTransport::pingAgent()
+{
+  m_pings++;
+  std::this_thread::sleep_for(m_options.latency * 2);
+
+  std::unique_lock<std::mutex> lock(m_lock);
+  const auto now = Clock::now();
+  if (agentReachable(now) && chance(m_options.agentDropRate)) {
+    m_outageEnd = now + m_options.outageDuration;
+  }
+
+  if (!agentReachable(now)) {
+    m_pingFailures++;
+    lock.unlock();
+    // Otherwise the bridge would retry without pause for the whole outage.
+    std::this_thread::sleep_for(kPingTimeout * kPingAttempts);
+    return false;
+  }
+  return true;
+}
+
+void LoopbackTransport::createEntities()
+{
+  std::lock_guard<std::mutex> lock(m_lock);
+  m_sessionOpen = true;
+  m_nextSample = Clock::now();
+  m_sessions++;
+}
+
+void LoopbackTransport::destroyEntities()
+{
+  std::lock_guard<std::mutex> lock(m_lock);
+  m_sessionOpen = false;
+  // Responses in flight are lost with the session.
+  m_responses = {};
+}
+
+bool LoopbackTransport::sendSetRequest(const ros2_android_vhal__srv__SetVehicleProperty_Request& request)
+{
+  std::lock_guard<std::mutex> lock(m_lock);
+  if (!m_sessionOpen) {
+    return false;
+  }
+
+  m_setRequests++;
+  if (chance(m_options.lossRate)) {
+    m_setsLost++;
+    return true;
+  }
+
+  int32_t result = kResultOk;
+  if (chance(m_options.ackFailureRate)) {
+    m_setsFailed++;
+    result = kResultOk + 1;
+  }
+  else if (isZonedBatch(request.prop) && decodeZonedBatch(request.prop).empty()) {
+    // An agent rejects a batch whose areas and values don't pair up.
+    ALOGW("LoopbackTransport - malformed zoned batch of %d rejected", request.prop.prop_id);
+    m_setsFailed++;
+    result = kResultOk + 1;
+  }
+
+  std::shared_ptr<const Echo> echo;
+  if (m_options.echoSets && result == kResultOk) {
+    echo = std::make_shared<const Echo>(request.prop);
+  }
+  m_responses.push({Clock::now() + m_options.latency, m_nextSequence++, result, false, 0, 0, std::move(echo)});
+  m_cv.notify_one();
+  return true;
+}
+
+bool LoopbackTransport::sendGetRequest(const ros2_android_vhal__srv__GetVehicleProperty_Request& request)
+{
+  std::lock_guard<std::mutex> lock(m_lock);
+  if (!m_sessionOpen) {
+    return false;
+  }
+
+  m_getRequests++;
+  if (chance(m_options.lossRate)) {
+    m_getsLost++;
+    return true;
+  }
+
+  m_responses.push(
+      {Clock::now() + m_options.latency, m_nextSequence++, kResultOk, true, request.prop_id, request.area_id, nullptr});
+  m_cv.notify_one();
+  return true;
+}
+
+void LoopbackTransport::deliver(const PendingResponse& pending)
+{
+  if (pending.get) {
+    SyntheticValue storage;
+    ros2_android_vhal__srv__GetVehicleProperty_Response response = {};
+    response.result = pending.result;
+    response.prop = make_synthetic_sample(pending.propId, pending.areaId, m_sampleCounter, clockOffsetNs(), storage);
+    if (m_onGetResponse) {
+      m_onGetResponse(response);
+    }
+  }
+  else {
+    ros2_android_vhal__srv__SetVehicleProperty_Response response;
+    response.result = pending.result;
+    if (m_onSetResponse) {
+      m_onSetResponse(response);
+    }
+
+    if (pending.echo) {
+      rosidl_runtime_c__String string;
+      const auto msg = pending.echo->msg(android::elapsedRealtimeNano() + clockOffsetNs(), string);
+      m_samplesPublished++;
+      if (m_onSample) {
+        m_onSample(msg);
+      }
+    }
+  }
+}
+
+void LoopbackTransport::spin(std::chrono::nanoseconds timeout)
+{
+  const auto deadline = Clock::now() + std::chrono::duration_cast<Clock::duration>(timeout);
+  const bool publishing = !m_options.syntheticPropIds.empty() && m_options.syntheticRateHz > 0;
+  const auto samplePeriod =
+      publishing ? std::chrono::duration_cast<Clock::duration>(std::chrono::seconds(1)) / m_options.syntheticRateHz
+                 : Clock::duration::zero();
+
+  std::unique_lock<std::mutex> lock(m_lock);
+  auto wakeup = deadline;
+  if (!m_responses.empty()) {
+    wakeup = std::min(wakeup, m_responses.top().due);
+  }
+  if (publishing) {
+    wakeup = std::min(wakeup, m_nextSample);
+  }
+  m_cv.wait_until(lock, wakeup, [this]() { return m_wakeup; });
+  m_wakeup = false;
+
+  const auto now = Clock::now();
+  while (!m_responses.empty() && m_responses.top().due <= now) {
+    const PendingResponse pending = m_responses.top();
+    m_responses.pop();
+
+    lock.unlock();
+    deliver(pending);
+    lock.lock();
+  }
+
+  if (publishing && m_nextSample <= now) {
+    m_nextSample += samplePeriod;
+    lock.unlock();
+    publishSamples();
+  }
+}
+
+void LoopbackTransport::wakeup()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_wakeup = true;
+  }
+  m_cv.notify_one();
+}
+
+std::optional<int64_t> LoopbackTransport::syncClock()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_lock);
+    if (!m_sessionOpen) {
+      return std::nullopt;
+    }
+  }
+
+  // A sync costs a round trip to the agent.
+  std::this_thread::sleep_for(m_options.latency * 2);
+  return android::elapsedRealtimeNano() + clockOffsetNs();
+}
+
+int64_t LoopbackTransport::clockOffsetNs() const
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(m_options.clockOffset).count();
+}
+
+void LoopbackTransport::publishSamples()
+{
+  const uint64_t counter = m_sampleCounter++;
+
+  for (const int32_t propId : m_options.syntheticPropIds) {
+    {
+      std::lock_guard<std::mutex> lock(m_lock);
+      if (chance(m_options.lossRate)) {
+        m_samplesLost++;
+        continue;
+      }
+    }
+
+    SyntheticValue storage;
+    const auto msg = make_synthetic_sample(propId, 0, counter, clockOffsetNs(), storage);
+
+    m_samplesPublished++;
+    if (m_onSample) {
+      m_onSample(msg);
+    }
+  }
+}
+
+LoopbackTransport::Stats LoopbackTransport::stats() const
+{
+  return Stats{
+      .pings = m_pings,
+      .pingFailures = m_pingFailures,
+      .sessions = m_sessions,
+      .setRequests = m_setRequests,
+      .setsLost = m_setsLost,
+      .setsFailed = m_setsFailed,
+      .getRequests = m_getRequests,
+      .getsLost = m_getsLost,
+      .samplesPublished = m_samplesPublished,
+      .samplesLost = m_samplesLost,
+  };
+}
+
+}  // namespace vendor::spyrosoft::vehicle::ros2
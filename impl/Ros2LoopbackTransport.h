@@ -0,0 +1,159 @@
+/*
+ * Copyright (c) 2023 Spyrosoft Synergy S.A.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <random>
+#include <vector>
+
+#include "Ros2Transport.h"
+
+namespace vendor::spyrosoft::vehicle::ros2 {
+
+/**
+ * @brief In-process stand-in for a micro-ROS agent and the vehicle behind it.
+ *
+ * Answers discovery and ping, serves /set_vehicle_property with configurable latency, loss and
+ * ACK failure rates, and publishes synthetic samples or echoes of the sets, so the bridge can be
+ * exercised on a host without an agent.
+ */
+class LoopbackTransport : public Transport {
+ public:
+  struct Options {
+    // One-way delay applied to responses and to ping round trips.
+    std::chrono::microseconds latency{0};
+    // Probability that a set request or a synthetic sample is dropped.
+    double lossRate = 0.0;
+    // Probability that a delivered set request is answered with a failure.
+    double ackFailureRate = 0.0;
+    // Probability that a ping starts an agent outage of outageDuration.
+    double agentDropRate = 0.0;
+    std::chrono::milliseconds outageDuration{1000};
+    // Synthetic vehicle signals, every property is published at syntheticRateHz.
+    std::vector<int32_t> syntheticPropIds;
+    uint32_t syntheticRateHz = 0;
+    // How far the simulated vehicle clock is ahead of elapsedRealtimeNano(), samples are stamped
+    // with it and syncClock() reports it.
+    std::chrono::milliseconds clockOffset{0};
+    // Publishes every acknowledged set request back as a sample, fragments included, as a vehicle
+    // that applies each value it is sent.
+    bool echoSets = false;
+    uint32_t seed = 0;
+  };
+
+  struct Stats {
+    uint64_t pings = 0;
+    uint64_t pingFailures = 0;
+    uint64_t sessions = 0;
+    uint64_t setRequests = 0;
+    uint64_t setsLost = 0;
+    uint64_t setsFailed = 0;
+    uint64_t getRequests = 0;
+    uint64_t getsLost = 0;
+    uint64_t samplesPublished = 0;
+    uint64_t samplesLost = 0;
+  };
+
+  explicit LoopbackTransport(Options options);
+
+  bool discoverAgent() override;
+  bool pingAgent() override;
+
+  void createEntities() override;
+  void destroyEntities() override;
+
+  bool sendSetRequest(const ros2_android_vhal__srv__SetVehicleProperty_Request& request) override;
+  // Gets are answered with a synthetic value after the configured latency, subject to loss.
+  bool sendGetRequest(const ros2_android_vhal__srv__GetVehicleProperty_Request& request) override;
+
+  void spin(std::chrono::nanoseconds timeout) override;
+  void wakeup() override;
+  std::optional<int64_t> syncClock() override;
+
+  Stats stats() const;
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  // Copy of a set request, the request itself is released once sendSetRequest() returns.
+  struct Echo;
+
+  struct PendingResponse {
+    Clock::time_point due;
+    // Keeps responses due at the same time in the order of their requests.
+    uint64_t sequence;
+    int32_t result;
+    // Set when answering a get request.
+    bool get;
+    int32_t propId;
+    int32_t areaId;
+    // Published once the set is acknowledged.
+    std::shared_ptr<const Echo> echo;
+
+    bool operator>(const PendingResponse& other) const
+    {
+      return (due != other.due) ? due > other.due : sequence > other.sequence;
+    }
+  };
+
+  const Options m_options;
+
+  std::mutex m_lock;
+  std::condition_variable m_cv;
+  std::mt19937 m_random;
+  bool m_sessionOpen = false;
+  bool m_wakeup = false;
+  Clock::time_point m_outageEnd;
+  Clock::time_point m_nextSample;
+  uint64_t m_nextSequence = 0;
+  // Also read by deliver(), which runs without m_lock.
+  std::atomic_uint64_t m_sampleCounter{0};
+  std::priority_queue<PendingResponse, std::vector<PendingResponse>, std::greater<PendingResponse>> m_responses;
+
+  std::atomic_uint64_t m_pings{0};
+  std::atomic_uint64_t m_pingFailures{0};
+  std::atomic_uint64_t m_sessions{0};
+  std::atomic_uint64_t m_setRequests{0};
+  std::atomic_uint64_t m_setsLost{0};
+  std::atomic_uint64_t m_setsFailed{0};
+  std::atomic_uint64_t m_getRequests{0};
+  std::atomic_uint64_t m_getsLost{0};
+  std::atomic_uint64_t m_samplesPublished{0};
+  std::atomic_uint64_t m_samplesLost{0};
+
+  // Must be called with m_lock held.
+  bool chance(double probability);
+  bool agentReachable(Clock::time_point now) const { return now >= m_outageEnd; }
+
+  void publishSamples();
+  int64_t clockOffsetNs() const;
+  void deliver(const PendingResponse& pending);
+};
+
+}  // namespace vendor::spyrosoft::vehicle::ros2
@@ -0,0 +1,625 @@
+/*
+ * Copyright (c) 2023 Spyrosoft Synergy S.A.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "Ros2MicroRosTransport.h"
+
+#include <rcl/error_handling.h>
+#include <rmw_microros/discovery.h>
+#include <rmw_microros/error_handling.h>
+#include <rmw_microros/ping.h>
+#include <rmw_microros/rmw_microros.h>
+#include <rosidl_runtime_c/primitives_sequence_functions.h>
+#include <rosidl_runtime_c/string_functions.h>
+#include <uxr/client/client.h>
+#include <uxr/client/config.h>
+
+#include <arpa/inet.h>
+#include <dirent.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <set>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Ros2PoolAllocator.h"
+#include "Ros2PropertyFragments.h"
+#include "common/logging.hpp"
+#include "common/rccheck.hpp"
+
+namespace {
+
+using vendor::spyrosoft::vehicle::ros2::MemorySubsystem;
+using vendor::spyrosoft::vehicle::ros2::MicroRosTransport;
+using vendor::spyrosoft::vehicle::ros2::PoolAllocator;
+
+// micro-ROS deserializes into preallocated memory, these bound a single inbound sample. Larger
+// STRING and BYTES values arrive in fragments of at most kMaxFragmentPayload bytes.
+constexpr size_t kMaxInboundValues = 32;
+constexpr size_t kMaxInboundStringSize = vendor::spyrosoft::vehicle::ros2::kMaxFragmentPayload;
+
+// Set and get clients, on-change and continuous subscriptions.
+constexpr size_t kExecutorHandles = 4;
+
+// Longest a single executor wait blocks when spin() can't wait on the session sockets. rmw_microxrcedds
+// only looks at guard conditions before it blocks on the XRCE session, so such a wait can't be
+// interrupted and this bounds how long a request queued by wakeup() waits for the session thread.
+constexpr std::chrono::milliseconds kSpinSlice{10};
+
+// The XRCE session only retransmits and sends heartbeats while it runs, so for this long after a
+// request spin() runs it at least every kSpinSlice.
+constexpr std::chrono::seconds kRetransmitWindow{1};
+
+// A sync round trip that takes longer than this yields an offset too coarse to be useful.
+constexpr int kTimeSyncTimeoutMs = 100;
+
+// Sessions to the same agent reuse its clock offset for this long instead of syncing again. Shorter
+// than the sync interval of the bridge, so every round syncs each agent once.
+constexpr std::chrono::seconds kAgentClockReuse{5};
+
+constexpr int kPingTimeoutMs = 250;
+constexpr uint8_t kPingAttempts = 5;
+
+constexpr const char *kVehiclePropertyTopic = "/vehicle_property";
+constexpr const char *kContinuousPropertyTopic = "/vehicle_property/continuous";
+
+// Continuous signals: only the latest sample matters.
+rmw_qos_profile_t continuous_property_qos()
+{
+  rmw_qos_profile_t qos = rmw_qos_profile_sensor_data;
+  qos.reliability = RMW_QOS_POLICY_RELIABILITY_BEST_EFFORT;
+  qos.history = RMW_QOS_POLICY_HISTORY_KEEP_LAST;
+  qos.depth = 1;
+  return qos;
+}
+
+void init_vehicle_property_msg(ros2_android_vhal__msg__VehicleProperty *msg)
+{
+  ros2_android_vhal__msg__VehicleProperty__init(msg);
+  rosidl_runtime_c__int64__Sequence__init(&msg->int64_values, kMaxInboundValues);
+  rosidl_runtime_c__int32__Sequence__init(&msg->int32_values, kMaxInboundValues);
+  rosidl_runtime_c__uint8__Sequence__init(&msg->uint8_values, kMaxInboundStringSize);
+  rosidl_runtime_c__float__Sequence__init(&msg->float_values, kMaxInboundValues);
+  rosidl_runtime_c__String__Sequence__init(&msg->string_values, 1UL);
+
+  std::string reserve(kMaxInboundStringSize, '\0');
+  rosidl_runtime_c__String__assignn(&msg->string_values.data[0], reserve.c_str(), reserve.size());
+
+  msg->int64_values.size = 0;
+  msg->int32_values.size = 0;
+  msg->uint8_values.size = 0;
+  msg->float_values.size = 0;
+  msg->string_values.size = 0;
+}
+
+static_assert(offsetof(MicroRosTransport::SetResponseSlot, response) == 0);
+
+void set_vehicle_property_callback(const void *msg)
+{
+  auto *slot = static_cast<const MicroRosTransport::SetResponseSlot *>(msg);
+  slot->owner->handleSetResponse(slot->response);
+}
+
+static_assert(offsetof(MicroRosTransport::GetResponseSlot, response) == 0);
+
+void get_vehicle_property_callback(const void *msg)
+{
+  auto *slot = static_cast<const MicroRosTransport::GetResponseSlot *>(msg);
+  slot->owner->handleGetResponse(slot->response);
+}
+
+void vehicle_property_callback(const void *msg, void *context)
+{
+  static_cast<MicroRosTransport *>(context)->handleSample(
+      *static_cast<const ros2_android_vhal__msg__VehicleProperty *>(msg));
+}
+
+// rmw_microxrcedds keeps the sessions and entities of all transports in process-wide pools, and
+// rmw_wait() runs every session of the pool. Creating and destroying entities changes the pools and
+// holds this lock exclusively. Sending and spinning only run sessions, which lock themselves when
+// the XRCE client is built with its multithread profile, so they hold it shared and the sessions
+// proceed in parallel. Without that profile sessions aren't thread safe and every call is
+// serialized. Discovery, pings and clock syncs use a transport of their own, they hold it shared so
+// that no socket is opened while createEntities() looks for the one of its session.
+std::shared_mutex &micro_ros_pool_lock()
+{
+  static std::shared_mutex lock;
+  return lock;
+}
+
+using PoolChangeLock = std::unique_lock<std::shared_mutex>;
+#ifdef UCLIENT_PROFILE_MULTITHREAD
+using SessionRunLock = std::shared_lock<std::shared_mutex>;
+#else
+using SessionRunLock = std::unique_lock<std::shared_mutex>;
+#endif
+
+struct OpenSession {
+  MicroRosTransport *transport;
+  // UDP socket of the XRCE session, -1 when it couldn't be identified.
+  int socket;
+};
+
+// Sessions of the pool with entities, changed under a PoolChangeLock.
+std::vector<OpenSession> open_sessions;
+
+// UDP sockets of the process connected to a peer. The XRCE UDP transport connects its socket to the
+// agent, rmw_microxrcedds doesn't expose it otherwise.
+std::set<int> connected_udp_sockets()
+{
+  struct DirCloser {
+    void operator()(DIR *dir) const { closedir(dir); }
+  };
+  std::set<int> sockets;
+  std::unique_ptr<DIR, DirCloser> dir(opendir("/proc/self/fd"));
+  if (!dir) {
+    return sockets;
+  }
+  while (const dirent *entry = readdir(dir.get())) {
+    char *end = nullptr;
+    const long fd = strtol(entry->d_name, &end, 10);
+    if (end == entry->d_name || *end != '\0' || fd == dirfd(dir.get())) {
+      continue;
+    }
+    int type = 0;
+    socklen_t typeLen = sizeof(type);
+    sockaddr_storage peer{};
+    socklen_t peerLen = sizeof(peer);
+    if (getsockopt(fd, SOL_SOCKET, SO_TYPE, &type, &typeLen) != 0 || type != SOCK_DGRAM ||
+        getpeername(fd, reinterpret_cast<sockaddr *>(&peer), &peerLen) != 0 ||
+        (peer.ss_family != AF_INET && peer.ss_family != AF_INET6)) {
+      continue;
+    }
+    sockets.insert(static_cast<int>(fd));
+  }
+  return sockets;
+}
+
+// Clock offset of an agent to uxr_nanos(), shared by the sessions connected to it.
+struct AgentClock {
+  std::mutex lock;
+  std::optional<int64_t> offsetNs;
+  std::chrono::steady_clock::time_point syncedAt;
+};
+
+AgentClock &agent_clock(const std::string &endpoint)
+{
+  static std::mutex lock;
+  static std::map<std::string, AgentClock> clocks;
+  std::lock_guard<std::mutex> guard(lock);
+  return clocks[endpoint];
+}
+
+// Syncs with the agent over a session of its own. rmw_uros_sync_session() only reaches the first
+// session of the pool, and the session handles of rmw_microxrcedds are private.
+std::optional<int64_t> sync_agent_clock(const MicroRosTransport::AgentEndpoint &agent)
+{
+  uxrUDPTransport transport;
+  if (!uxr_init_udp_transport(&transport, agent.ipv6 ? UXR_IPv6 : UXR_IPv4, agent.ip.c_str(), agent.port.c_str())) {
+    return std::nullopt;
+  }
+
+  std::optional<int64_t> offsetNs;
+  uxrSession session;
+  uxr_init_session(&session, &transport.comm, std::random_device{}());
+  if (uxr_create_session_retries(&session, 1)) {
+    if (uxr_sync_session(&session, kTimeSyncTimeoutMs)) {
+      offsetNs = session.time_offset;
+    }
+    uxr_delete_session_retries(&session, 1);
+  }
+  uxr_close_udp_transport(&transport);
+  return offsetNs;
+}
+
+// The pooled allocator of the subsystem when one is installed, the system heap otherwise.
+rcl_allocator_t allocator_for(MemorySubsystem subsystem)
+{
+  auto *pool = PoolAllocator::installed();
+  return (pool != nullptr) ? pool->allocator(subsystem) : rcutils_get_default_allocator();
+}
+
+}  // namespace
+
+namespace vendor::spyrosoft::vehicle::ros2 {
+
+MicroRosTransport::MicroRosTransport(Options options)
+    : m_options(std::move(options)),
+      m_init_options(rcl_get_zero_initialized_init_options()),
+      m_allocator(allocator_for(MemorySubsystem::SUPPORT)),
+      m_executorAllocator(allocator_for(MemorySubsystem::EXECUTOR)),
+      m_node(rcl_get_zero_initialized_node()),
+      m_executor(rclc_executor_get_zero_initialized_executor()),
+      m_vehiclePropertyClient(rcl_get_zero_initialized_client()),
+      m_getPropertyClient(rcl_get_zero_initialized_client()),
+      m_vehiclePropertySubscription(rcl_get_zero_initialized_subscription()),
+      m_continuousPropertySubscription(rcl_get_zero_initialized_subscription()),
+      m_wakeupFd(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK))
+{
+  if (m_wakeupFd < 0) {
+    ALOGE("MicroRosTransport - eventfd failed: %s", strerror(errno));
+  }
+  RCCHECK(rcl_init_options_init(&m_init_options, m_allocator));
+  ros2_android_vhal__srv__SetVehicleProperty_Response__init(&m_setResponse.response);
+  m_setResponse.owner = this;
+  ros2_android_vhal__srv__GetVehicleProperty_Response__init(&m_getResponse.response);
+  init_vehicle_property_msg(&m_getResponse.response.prop);
+  m_getResponse.owner = this;
+  init_vehicle_property_msg(&m_vehiclePropertyMsg);
+  init_vehicle_property_msg(&m_continuousPropertyMsg);
+}
+
+MicroRosTransport::~MicroRosTransport()
+{
+  ros2_android_vhal__msg__VehicleProperty__fini(&m_continuousPropertyMsg);
+  ros2_android_vhal__msg__VehicleProperty__fini(&m_vehiclePropertyMsg);
+  ros2_android_vhal__srv__GetVehicleProperty_Response__fini(&m_getResponse.response);
+  ros2_android_vhal__srv__SetVehicleProperty_Response__fini(&m_setResponse.response);
+  RCSOFTCHECK(rcl_init_options_fini(&m_init_options));
+}
+
+bool MicroRosTransport::discoverAgent()
+{
+  if (!m_options.agentAddress.empty()) {
+    const auto separator = m_options.agentAddress.rfind(':');
+    const std::string ip = m_options.agentAddress.substr(0, separator);
+    const std::string port = (separator == std::string::npos) ? "8888" : m_options.agentAddress.substr(separator + 1);
+
+    m_rmw_options = rcl_init_options_get_rmw_init_options(&m_init_options);
+    if (rmw_uros_options_set_udp_address(ip.c_str(), port.c_str(), m_rmw_options) == RMW_RET_OK) {
+      return true;
+    }
+    ALOGE("MicroRosTransport - invalid agent address %s", m_options.agentAddress.c_str());
+    m_rmw_options = nullptr;
+    return false;
+  }
+
+  std::shared_lock<std::shared_mutex> poolLock(micro_ros_pool_lock());
+  m_rmw_options = rcl_init_options_get_rmw_init_options(&m_init_options);
+  if (rmw_uros_discover_agent(m_rmw_options) == RMW_RET_OK) {
+    return true;
+  }
+
+  m_rmw_options = nullptr;
+  return false;
+}
+
+bool MicroRosTransport::pingAgent()
+{
+  // Without options the agent of this session is unknown. rmw_uros_ping_agent() would ping over
+  // every session of the pool and may be answered by the agent of another one.
+  if (m_rmw_options == nullptr) {
+    // Takes as long as an unanswered ping, the bridge retries right away.
+    std::this_thread::sleep_for(std::chrono::milliseconds(kPingTimeoutMs) * kPingAttempts);
+    return false;
+  }
+  std::shared_lock<std::shared_mutex> poolLock(micro_ros_pool_lock());
+  return (rmw_uros_ping_agent_options(kPingTimeoutMs, kPingAttempts, m_rmw_options) == RMW_RET_OK);
+}
+
+void MicroRosTransport::createEntities()
+{
+  ALOGI("MicroRosTransport - initializing node entities of %s", m_options.nodeName.c_str());
+  PoolChangeLock poolLock(micro_ros_pool_lock());
+  std::lock_guard<std::mutex> lock(m_sessionLock);
+
+  // Only called once pingAgent() reached the agent of m_rmw_options. The socket the session opens is
+  // the one spin() waits on.
+  const std::set<int> socketsBefore = connected_udp_sockets();
+  RCCHECK(rclc_support_init_with_options(&m_support, 0, nullptr, &m_init_options, &m_allocator));
+  std::vector<int> sessionSockets;
+  for (int fd : connected_udp_sockets()) {
+    if (socketsBefore.count(fd) == 0) {
+      sessionSockets.push_back(fd);
+    }
+  }
+  const int sessionSocket = (sessionSockets.size() == 1) ? sessionSockets.front() : -1;
+  if (sessionSocket < 0) {
+    ALOGW("MicroRosTransport - socket of %s not found, waits in %lld ms slices", m_options.nodeName.c_str(),
+          (long long)kSpinSlice.count());
+  }
+  m_agent = agentEndpoint(sessionSocket);
+
+  RCCHECK(rclc_node_init_default(&m_node, m_options.nodeName.c_str(), "", &m_support));
+
+  RCCHECK(rclc_client_init_default(&m_vehiclePropertyClient, &m_node,
+                                   ROSIDL_GET_SRV_TYPE_SUPPORT(ros2_android_vhal, srv, SetVehicleProperty),
+                                   "/set_vehicle_property"));
+
+  RCCHECK(rclc_client_init_default(&m_getPropertyClient, &m_node,
+                                   ROSIDL_GET_SRV_TYPE_SUPPORT(ros2_android_vhal, srv, GetVehicleProperty),
+                                   "/get_vehicle_property"));
+
+  RCCHECK(rclc_subscription_init_default(&m_vehiclePropertySubscription, &m_node,
+                                         ROSIDL_GET_MSG_TYPE_SUPPORT(ros2_android_vhal, msg, VehicleProperty),
+                                         kVehiclePropertyTopic));
+
+  const rmw_qos_profile_t continuousQos = continuous_property_qos();
+  RCCHECK(rclc_subscription_init(&m_continuousPropertySubscription, &m_node,
+                                 ROSIDL_GET_MSG_TYPE_SUPPORT(ros2_android_vhal, msg, VehicleProperty),
+                                 kContinuousPropertyTopic, &continuousQos));
+
+  RCCHECK(rclc_executor_init(&m_executor, &m_support.context, kExecutorHandles, &m_executorAllocator));
+  RCCHECK(rclc_executor_set_trigger(&m_executor, rclc_executor_trigger_any, nullptr));
+
+  RCCHECK(rclc_executor_add_client(&m_executor, &m_vehiclePropertyClient, &m_setResponse.response,
+                                   set_vehicle_property_callback));
+  RCCHECK(rclc_executor_add_client(&m_executor, &m_getPropertyClient, &m_getResponse.response,
+                                   get_vehicle_property_callback));
+  RCCHECK(rclc_executor_add_subscription_with_context(&m_executor, &m_vehiclePropertySubscription,
+                                                      &m_vehiclePropertyMsg, vehicle_property_callback, this,
+                                                      ON_NEW_DATA));
+  RCCHECK(rclc_executor_add_subscription_with_context(&m_executor, &m_continuousPropertySubscription,
+                                                      &m_continuousPropertyMsg, vehicle_property_callback, this,
+                                                      ON_NEW_DATA));
+
+  m_entitiesCreated = true;
+  open_sessions.push_back({this, sessionSocket});
+  // Other session threads may be waiting on the sockets of the pool without this one.
+  for (const OpenSession &session : open_sessions) {
+    session.transport->wakeup();
+  }
+}
+
+void MicroRosTransport::destroyEntities()
+{
+  ALOGI("MicroRosTransport - destroying node entities of %s", m_options.nodeName.c_str());
+  PoolChangeLock poolLock(micro_ros_pool_lock());
+  std::lock_guard<std::mutex> lock(m_sessionLock);
+  if (m_entitiesCreated) {
+    open_sessions.erase(std::find_if(open_sessions.begin(), open_sessions.end(),
+                                     [this](const OpenSession &session) { return session.transport == this; }));
+    for (const OpenSession &session : open_sessions) {
+      session.transport->wakeup();
+    }
+  }
+  m_entitiesCreated = false;
+
+  RCSOFTCHECK(rclc_executor_fini(&m_executor));
+  RCSOFTCHECK(rcl_subscription_fini(&m_continuousPropertySubscription, &m_node));
+  RCSOFTCHECK(rcl_subscription_fini(&m_vehiclePropertySubscription, &m_node));
+  RCSOFTCHECK(rcl_client_fini(&m_getPropertyClient, &m_node));
+  RCSOFTCHECK(rcl_client_fini(&m_vehiclePropertyClient, &m_node));
+  RCSOFTCHECK(rcl_node_fini(&m_node));
+  RCSOFTCHECK(rclc_support_fini(&m_support));
+}
+
+bool MicroRosTransport::sendSetRequest(const ros2_android_vhal__srv__SetVehicleProperty_Request &request)
+{
+  SessionRunLock poolLock(micro_ros_pool_lock());
+  std::lock_guard<std::mutex> lock(m_sessionLock);
+
+  int64_t sequence_number;
+  m_lastRequest = std::chrono::steady_clock::now();
+  return (rcl_send_request(&m_vehiclePropertyClient, &request, &sequence_number) == RCL_RET_OK);
+}
+
+bool MicroRosTransport::sendGetRequest(const ros2_android_vhal__srv__GetVehicleProperty_Request &request)
+{
+  SessionRunLock poolLock(micro_ros_pool_lock());
+  std::lock_guard<std::mutex> lock(m_sessionLock);
+
+  int64_t sequence_number;
+  m_lastRequest = std::chrono::steady_clock::now();
+  return (rcl_send_request(&m_getPropertyClient, &request, &sequence_number) == RCL_RET_OK);
+}
+
+void MicroRosTransport::spin(std::chrono::nanoseconds timeout)
+{
+  const auto deadline = std::chrono::steady_clock::now() + timeout;
+
+  // Sends what was queued and dispatches what already arrived.
+  if (spinSome(std::chrono::nanoseconds::zero()) || consumeWakeup()) {
+    return;
+  }
+
+  // rmw_wait() runs every session of the pool, so a sample of this session may be read on another
+  // session thread. The wait covers the sockets of all of them, and a thread that read a datagram
+  // wakes the others to dispatch what it left for them.
+  std::vector<pollfd> fds;
+  {
+    std::shared_lock<std::shared_mutex> poolLock(micro_ros_pool_lock());
+    for (const OpenSession &session : open_sessions) {
+      if (session.socket < 0) {
+        fds.clear();
+        break;
+      }
+      fds.push_back({session.socket, POLLIN, 0});
+    }
+  }
+  if (fds.empty() || m_wakeupFd < 0) {
+    spinSliced(deadline);
+    return;
+  }
+  fds.push_back({m_wakeupFd.get(), POLLIN, 0});
+
+  const auto now = std::chrono::steady_clock::now();
+  auto wait = std::max<std::chrono::nanoseconds>(deadline - now, std::chrono::nanoseconds::zero());
+  if (now - m_lastRequest < kRetransmitWindow) {
+    wait = std::min<std::chrono::nanoseconds>(wait, kSpinSlice);
+  }
+  const auto waitMs = std::chrono::ceil<std::chrono::milliseconds>(wait);
+  if (TEMP_FAILURE_RETRY(poll(fds.data(), fds.size(), static_cast<int>(waitMs.count()))) < 0) {
+    ALOGE("MicroRosTransport - poll failed: %s", strerror(errno));
+  }
+
+  consumeWakeup();
+  spinSome(std::chrono::nanoseconds::zero());
+
+  const bool datagram =
+      std::any_of(fds.begin(), fds.end() - 1, [](const pollfd &fd) { return (fd.revents & POLLIN) != 0; });
+  if (datagram) {
+    std::shared_lock<std::shared_mutex> poolLock(micro_ros_pool_lock());
+    for (const OpenSession &session : open_sessions) {
+      if (session.transport != this) {
+        session.transport->wakeup();
+      }
+    }
+  }
+}
+
+void MicroRosTransport::spinSliced(std::chrono::steady_clock::time_point deadline)
+{
+  while (!consumeWakeup()) {
+    const auto remaining =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - std::chrono::steady_clock::now());
+    const auto slice = std::clamp<std::chrono::nanoseconds>(remaining, std::chrono::nanoseconds::zero(), kSpinSlice);
+    if (spinSome(slice) || slice >= remaining) {
+      return;
+    }
+  }
+  spinSome(std::chrono::nanoseconds::zero());
+}
+
+bool MicroRosTransport::spinSome(std::chrono::nanoseconds timeout)
+{
+  SessionRunLock poolLock(micro_ros_pool_lock());
+  std::lock_guard<std::mutex> lock(m_sessionLock);
+  m_dispatched = false;
+  // rclc reports a timeout as success, whether anything ran is tracked by the callbacks.
+  const rcl_ret_t rc = rclc_executor_spin_some(&m_executor, timeout.count());
+  if (rc != RCL_RET_OK && rc != RCL_RET_TIMEOUT) {
+    ALOGE("MicroRosTransport - spin failed: %d", (int)rc);
+  }
+  return m_dispatched;
+}
+
+bool MicroRosTransport::consumeWakeup()
+{
+  uint64_t count = 0;
+  return (m_wakeupFd >= 0) && (TEMP_FAILURE_RETRY(read(m_wakeupFd.get(), &count, sizeof(count))) > 0);
+}
+
+void MicroRosTransport::wakeup()
+{
+  // Only signals the session thread, micro-ROS is never called from the caller's thread.
+  const uint64_t one = 1;
+  if (m_wakeupFd >= 0 && TEMP_FAILURE_RETRY(write(m_wakeupFd.get(), &one, sizeof(one))) < 0) {
+    ALOGE("MicroRosTransport - wakeup failed: %s", strerror(errno));
+  }
+}
+
+std::optional<MicroRosTransport::AgentEndpoint> MicroRosTransport::agentEndpoint(int sessionSocket) const
+{
+  // The session socket is connected to the agent, whether it was configured or discovered.
+  sockaddr_storage peer{};
+  socklen_t peerLen = sizeof(peer);
+  if (sessionSocket >= 0 && getpeername(sessionSocket, reinterpret_cast<sockaddr *>(&peer), &peerLen) == 0) {
+    char ip[INET6_ADDRSTRLEN] = {};
+    if (peer.ss_family == AF_INET) {
+      const auto *address = reinterpret_cast<const sockaddr_in *>(&peer);
+      inet_ntop(AF_INET, &address->sin_addr, ip, sizeof(ip));
+      return AgentEndpoint{ip, std::to_string(ntohs(address->sin_port)), false};
+    }
+    if (peer.ss_family == AF_INET6) {
+      const auto *address = reinterpret_cast<const sockaddr_in6 *>(&peer);
+      inet_ntop(AF_INET6, &address->sin6_addr, ip, sizeof(ip));
+      return AgentEndpoint{ip, std::to_string(ntohs(address->sin6_port)), true};
+    }
+  }
+
+  if (!m_options.agentAddress.empty()) {
+    const auto separator = m_options.agentAddress.rfind(':');
+    return AgentEndpoint{m_options.agentAddress.substr(0, separator),
+                         (separator == std::string::npos) ? "8888" : m_options.agentAddress.substr(separator + 1),
+                         false};
+  }
+  return std::nullopt;
+}
+
+std::optional<int64_t> MicroRosTransport::syncClock()
+{
+  std::optional<AgentEndpoint> agent;
+  {
+    std::lock_guard<std::mutex> lock(m_sessionLock);
+    if (!m_entitiesCreated) {
+      return std::nullopt;
+    }
+    agent = m_agent;
+  }
+
+  if (!agent) {
+    if (!m_clockSyncSkipped) {
+      ALOGW("MicroRosTransport - agent of %s unknown, clock left unsynced", m_options.nodeName.c_str());
+      m_clockSyncSkipped = true;
+    }
+    return std::nullopt;
+  }
+
+  // Sessions to the same agent sync once and share the offset.
+  AgentClock &clock = agent_clock(agent->ip + ":" + agent->port);
+  std::lock_guard<std::mutex> lock(clock.lock);
+  const auto now = std::chrono::steady_clock::now();
+  if (!clock.offsetNs || now - clock.syncedAt >= kAgentClockReuse) {
+    // Its socket must not show up while createEntities() looks for the one of a new session.
+    std::shared_lock<std::shared_mutex> poolLock(micro_ros_pool_lock());
+    clock.offsetNs = sync_agent_clock(*agent);
+    clock.syncedAt = now;
+    if (!clock.offsetNs) {
+      ALOGW("MicroRosTransport - time sync of %s with %s:%s failed", m_options.nodeName.c_str(), agent->ip.c_str(),
+            agent->port.c_str());
+    }
+  }
+  if (!clock.offsetNs) {
+    return std::nullopt;
+  }
+  return uxr_nanos() + *clock.offsetNs;
+}
+
+void MicroRosTransport::handleSample(const ros2_android_vhal__msg__VehicleProperty &msg)
+{
+  m_dispatched = true;
+  if (m_onSample) {
+    m_onSample(msg);
+  }
+}
+
+void MicroRosTransport::handleSetResponse(const ros2_android_vhal__srv__SetVehicleProperty_Response &response)
+{
+  m_dispatched = true;
+  if (m_onSetResponse) {
+    m_onSetResponse(response);
+  }
+}
+
+void MicroRosTransport::handleGetResponse(const ros2_android_vhal__srv__GetVehicleProperty_Response &response)
+{
+  m_dispatched = true;
+  if (m_onGetResponse) {
+    m_onGetResponse(response);
+  }
+}
+
+}  // namespace vendor::spyrosoft::vehicle::ros2
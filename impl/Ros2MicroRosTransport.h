@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2023 Spyrosoft Synergy S.A.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <rcl/rcl.h>
+#include <rclc/executor.h>
+#include <rclc/rclc.h>
+
+#include <android-base/unique_fd.h>
+
+#include <chrono>
+#include <mutex>
+#include <optional>
+#include <string>
+
+#include "Ros2Transport.h"
+
+namespace vendor::spyrosoft::vehicle::ros2 {
+
+/**
+ * @brief Transport over a micro-ROS XRCE-DDS session to an agent discovered on the network.
+ *
+ * Inbound samples arrive on two topics. On-change properties use a reliable subscription on
+ * "/vehicle_property". Continuous signals use a best-effort, keep-last subscription on
+ * "/vehicle_property/continuous": a stale sample is superseded by the next one, so it is not
+ * worth a retransmit. rmw_microxrcedds maps best-effort entities to the best-effort XRCE stream,
+ * so continuous traffic never blocks the reliable stream that carries set requests.
+ *
+ * The executor dispatches as soon as any handle has data. A wait of the executor can't be
+ * interrupted, so spin() instead polls the UDP sockets of the sessions together with an eventfd
+ * that wakeup() signals, and then runs the executor without waiting. For a second after a request
+ * it wakes every 10 ms to let the session retransmit. When a session socket can't be identified
+ * spin() falls back to executor waits of at most 10 ms.
+ *
+ * Several transports may live in one process, each on its own session thread. Each session has a
+ * lock of its own. Only changes to the entity pools shared by all sessions are serialized across
+ * the process, and every call when the XRCE client lacks its multithread profile. The time sync of
+ * micro-ROS only reaches the first session of the process, so each agent is synced over an XRCE
+ * session of its own, once per sync round however many sessions connect to it.
+ */
+class MicroRosTransport : public Transport {
+ public:
+  struct Options {
+    // Node names must be unique across the sessions of one process.
+    std::string nodeName = "android_vhal_node";
+    // "ip:port" of the agent, the agent is discovered over multicast when empty.
+    std::string agentAddress;
+  };
+
+  explicit MicroRosTransport(Options options);
+  ~MicroRosTransport() override;
+
+  bool discoverAgent() override;
+  bool pingAgent() override;
+
+  void createEntities() override;
+  void destroyEntities() override;
+
+  bool sendSetRequest(const ros2_android_vhal__srv__SetVehicleProperty_Request& request) override;
+  bool sendGetRequest(const ros2_android_vhal__srv__GetVehicleProperty_Request& request) override;
+
+  void spin(std::chrono::nanoseconds timeout) override;
+  void wakeup() override;
+
+  // Runs an XRCE time sync round with the agent of this session, only available while the entities
+  // exist. Samples of an unsynced session are stamped on arrival.
+  std::optional<int64_t> syncClock() override;
+
+  // Entry points of the rclc executor callbacks.
+  void handleSample(const ros2_android_vhal__msg__VehicleProperty& msg);
+  void handleSetResponse(const ros2_android_vhal__srv__SetVehicleProperty_Response& response);
+  void handleGetResponse(const ros2_android_vhal__srv__GetVehicleProperty_Response& response);
+
+  const std::string& nodeName() const { return m_options.nodeName; }
+
+  // Storage the executor deserializes a response into, tagged with its owner because rclc client
+  // callbacks carry no context pointer.
+  struct SetResponseSlot {
+    ros2_android_vhal__srv__SetVehicleProperty_Response response;
+    MicroRosTransport* owner;
+  };
+  struct GetResponseSlot {
+    ros2_android_vhal__srv__GetVehicleProperty_Response response;
+    MicroRosTransport* owner;
+  };
+
+  struct AgentEndpoint {
+    std::string ip;
+    std::string port;
+    bool ipv6 = false;
+  };
+
+ private:
+  const Options m_options;
+
+  rcl_init_options_t m_init_options;
+  rmw_init_options_t* m_rmw_options = nullptr;
+  rclc_support_t m_support;
+  rcl_allocator_t m_allocator;
+  rcl_allocator_t m_executorAllocator;
+  rcl_node_t m_node;
+  rclc_executor_t m_executor;
+
+  // Runs the executor once, true when a callback ran.
+  bool spinSome(std::chrono::nanoseconds timeout);
+  void spinSliced(std::chrono::steady_clock::time_point deadline);
+  // Resets the wakeup eventfd, true when it was signalled.
+  bool consumeWakeup();
+  // Address of the agent the session socket is connected to, the configured one otherwise.
+  std::optional<AgentEndpoint> agentEndpoint(int sessionSocket) const;
+
+  // Guards the entities of this session.
+  std::mutex m_sessionLock;
+  bool m_entitiesCreated = false;
+  bool m_dispatched = false;
+  std::optional<AgentEndpoint> m_agent;
+  std::chrono::steady_clock::time_point m_lastRequest;
+  bool m_clockSyncSkipped = false;
+
+  rcl_client_t m_vehiclePropertyClient;
+  SetResponseSlot m_setResponse;
+
+  rcl_client_t m_getPropertyClient;
+  GetResponseSlot m_getResponse;
+
+  rcl_subscription_t m_vehiclePropertySubscription;
+  ros2_android_vhal__msg__VehicleProperty m_vehiclePropertyMsg;
+
+  rcl_subscription_t m_continuousPropertySubscription;
+  ros2_android_vhal__msg__VehicleProperty m_continuousPropertyMsg;
+
+  // Signalled by wakeup(), from any thread.
+  android::base::unique_fd m_wakeupFd;
+};
+
+}  // namespace vendor::spyrosoft::vehicle::ros2
@@ -0,0 +1,259 @@
+/*
+ * Copyright (c) 2023 Spyrosoft Synergy S.A.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "Ros2PoolAllocator.h"
+
+#include <android-base/stringprintf.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include "common/logging.hpp"
+
+namespace vendor::spyrosoft::vehicle::ros2 {
+
+namespace {
+
+// Smallest block is 32 bytes, the size classes double from there.
+constexpr size_t kMinBlockShift = 5;
+constexpr uint32_t kHeapClass = UINT32_MAX;
+
+// Precedes every allocation, keeps the payload aligned like malloc does.
+struct alignas(alignof(std::max_align_t)) BlockHeader {
+  uint32_t sizeClass;
+  uint32_t subsystem;
+  size_t size;
+};
+
+size_t class_size(size_t sizeClass) { return size_t{1} << (sizeClass + kMinBlockShift); }
+
+// kSizeClasses when no block is large enough.
+size_t size_class_of(size_t size, size_t sizeClasses)
+{
+  size_t sizeClass = 0;
+  while (sizeClass < sizeClasses && class_size(sizeClass) < size) {
+    sizeClass++;
+  }
+  return sizeClass;
+}
+
+BlockHeader* header_of(void* pointer) { return static_cast<BlockHeader*>(pointer) - 1; }
+
+PoolAllocator* gInstalled = nullptr;
+
+}  // namespace
+
+const char* toString(MemorySubsystem subsystem)
+{
+  switch (subsystem) {
+    case MemorySubsystem::RCL:
+      return "rcl";
+    case MemorySubsystem::SUPPORT:
+      return "support";
+    case MemorySubsystem::EXECUTOR:
+      return "executor";
+    default:
+      return "unknown";
+  }
+}
+
+PoolAllocator* PoolAllocator::install(size_t arenaSize)
+{
+  // Lives as long as the process, micro-ROS may free memory up to its very end.
+  static PoolAllocator* pool = new PoolAllocator(arenaSize);
+
+  rcutils_allocator_t defaultAllocator = pool->allocator(MemorySubsystem::RCL);
+  if (!rcutils_set_default_allocator(&defaultAllocator)) {
+    ALOGE("PoolAllocator - failed to set the rcutils default allocator");
+    return nullptr;
+  }
+  gInstalled = pool;
+  ALOGI("PoolAllocator - %zu bytes reserved for micro-ROS", arenaSize);
+  return pool;
+}
+
+PoolAllocator* PoolAllocator::installed() { return gInstalled; }
+
+PoolAllocator::PoolAllocator(size_t arenaSize) : m_arena(new uint8_t[arenaSize]), m_arenaSize(arenaSize)
+{
+  for (size_t i = 0; i < m_tags.size(); i++) {
+    m_tags[i] = Tag{this, static_cast<MemorySubsystem>(i)};
+  }
+}
+
+rcutils_allocator_t PoolAllocator::allocator(MemorySubsystem subsystem)
+{
+  rcutils_allocator_t allocator = rcutils_get_zero_initialized_allocator();
+  allocator.allocate = allocateCallback;
+  allocator.deallocate = deallocateCallback;
+  allocator.reallocate = reallocateCallback;
+  allocator.zero_allocate = zeroAllocateCallback;
+  allocator.state = &m_tags[static_cast<size_t>(subsystem)];
+  return allocator;
+}
+
+void* PoolAllocator::allocate(size_t size, MemorySubsystem subsystem)
+{
+  const size_t sizeClass = size_class_of(size, kSizeClasses);
+
+  std::lock_guard<std::mutex> lock(m_lock);
+  BlockHeader* header = nullptr;
+  if (sizeClass < kSizeClasses) {
+    if (void* block = m_freeLists[sizeClass]; block != nullptr) {
+      header = static_cast<BlockHeader*>(block);
+      m_freeLists[sizeClass] = *reinterpret_cast<void**>(header + 1);
+    }
+    else if (m_arenaUsed + sizeof(BlockHeader) + class_size(sizeClass) <= m_arenaSize) {
+      header = reinterpret_cast<BlockHeader*>(m_arena.get() + m_arenaUsed);
+      m_arenaUsed += sizeof(BlockHeader) + class_size(sizeClass);
+    }
+  }
+
+  if (header != nullptr) {
+    header->sizeClass = static_cast<uint32_t>(sizeClass);
+  }
+  else {
+    header = static_cast<BlockHeader*>(std::malloc(sizeof(BlockHeader) + size));
+    if (header == nullptr) {
+      return nullptr;
+    }
+    header->sizeClass = kHeapClass;
+    m_overflows++;
+  }
+  header->subsystem = static_cast<uint32_t>(subsystem);
+  header->size = size;
+
+  auto& stats = m_subsystems[static_cast<size_t>(subsystem)];
+  stats.currentBytes += size;
+  stats.peakBytes = std::max(stats.peakBytes, stats.currentBytes);
+  stats.allocations++;
+  return header + 1;
+}
+
+void PoolAllocator::deallocate(void* pointer)
+{
+  if (pointer == nullptr) {
+    return;
+  }
+  BlockHeader* header = header_of(pointer);
+
+  std::lock_guard<std::mutex> lock(m_lock);
+  // Accounted to the subsystem that allocated it, whichever allocator frees it.
+  auto& stats = m_subsystems[header->subsystem];
+  stats.currentBytes -= header->size;
+  stats.frees++;
+
+  if (header->sizeClass == kHeapClass) {
+    std::free(header);
+  }
+  else {
+    *reinterpret_cast<void**>(header + 1) = m_freeLists[header->sizeClass];
+    m_freeLists[header->sizeClass] = header;
+  }
+}
+
+void* PoolAllocator::reallocate(void* pointer, size_t size, MemorySubsystem subsystem)
+{
+  if (pointer == nullptr) {
+    return allocate(size, subsystem);
+  }
+
+  BlockHeader* header = header_of(pointer);
+  {
+    std::lock_guard<std::mutex> lock(m_lock);
+    if (header->sizeClass != kHeapClass && size <= class_size(header->sizeClass)) {
+      // Still fits its block.
+      auto& stats = m_subsystems[header->subsystem];
+      stats.currentBytes = stats.currentBytes - header->size + size;
+      stats.peakBytes = std::max(stats.peakBytes, stats.currentBytes);
+      header->size = size;
+      return pointer;
+    }
+  }
+
+  void* moved = allocate(size, static_cast<MemorySubsystem>(header->subsystem));
+  if (moved == nullptr) {
+    return nullptr;
+  }
+  std::memcpy(moved, pointer, std::min(size, header->size));
+  deallocate(pointer);
+  return moved;
+}
+
+void* PoolAllocator::allocateCallback(size_t size, void* state)
+{
+  auto* tag = static_cast<Tag*>(state);
+  return tag->pool->allocate(size, tag->subsystem);
+}
+
+void PoolAllocator::deallocateCallback(void* pointer, void* state)
+{
+  static_cast<Tag*>(state)->pool->deallocate(pointer);
+}
+
+void* PoolAllocator::reallocateCallback(void* pointer, size_t size, void* state)
+{
+  auto* tag = static_cast<Tag*>(state);
+  return tag->pool->reallocate(pointer, size, tag->subsystem);
+}
+
+void* PoolAllocator::zeroAllocateCallback(size_t count, size_t size, void* state)
+{
+  if (size != 0 && count > SIZE_MAX / size) {
+    return nullptr;
+  }
+  void* pointer = allocateCallback(count * size, state);
+  if (pointer != nullptr) {
+    std::memset(pointer, 0, count * size);
+  }
+  return pointer;
+}
+
+PoolAllocator::Stats PoolAllocator::stats() const
+{
+  std::lock_guard<std::mutex> lock(m_lock);
+  return Stats{
+      .arenaSize = m_arenaSize,
+      .arenaUsed = m_arenaUsed,
+      .overflows = m_overflows,
+      .subsystems = m_subsystems,
+  };
+}
+
+std::string PoolAllocator::dump() const
+{
+  const Stats current = stats();
+  std::string buffer = android::base::StringPrintf("micro-ROS pool: %zu of %zu bytes carved, %llu heap overflows\n",
+                                                   current.arenaUsed, current.arenaSize,
+                                                   static_cast<unsigned long long>(current.overflows));
+  for (size_t i = 0; i < current.subsystems.size(); i++) {
+    const auto& subsystem = current.subsystems[i];
+    buffer += android::base::StringPrintf("  %s: %zu bytes in use, %zu peak, %llu allocations, %llu frees\n",
+                                          toString(static_cast<MemorySubsystem>(i)), subsystem.currentBytes,
+                                          subsystem.peakBytes, static_cast<unsigned long long>(subsystem.allocations),
+                                          static_cast<unsigned long long>(subsystem.frees));
+  }
+  return buffer;
+}
+
+}  // namespace vendor::spyrosoft::vehicle::ros2
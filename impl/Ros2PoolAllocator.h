@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2023 Spyrosoft Synergy S.A.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <rcutils/allocator.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace vendor::spyrosoft::vehicle::ros2 {
+
+// Users of micro-ROS memory, accounted separately.
+enum class MemorySubsystem { RCL, SUPPORT, EXECUTOR, COUNT };
+
+const char* toString(MemorySubsystem subsystem);
+
+/**
+ * @brief Bounded pool behind every micro-ROS and rcl allocation of the process.
+ *
+ * The arena is reserved once at startup and carved into power-of-two blocks on demand. Freed
+ * blocks are kept on per-size free lists, so reconnect cycles reuse the same memory instead of
+ * going through the system heap. Requests larger than the biggest block, or made once the arena
+ * is used up, still go to the heap and are counted as overflows.
+ */
+class PoolAllocator {
+ public:
+  struct SubsystemStats {
+    size_t currentBytes = 0;
+    size_t peakBytes = 0;
+    uint64_t allocations = 0;
+    uint64_t frees = 0;
+  };
+
+  struct Stats {
+    size_t arenaSize = 0;
+    size_t arenaUsed = 0;
+    uint64_t overflows = 0;
+    std::array<SubsystemStats, static_cast<size_t>(MemorySubsystem::COUNT)> subsystems;
+  };
+
+  // Creates the process-wide pool and makes it the rcutils default allocator. Must run before
+  // anything is allocated through rcutils, memory from another allocator cannot be freed here.
+  static PoolAllocator* install(size_t arenaSize);
+
+  // The pool installed by install(), nullptr when micro-ROS uses the system heap.
+  static PoolAllocator* installed();
+
+  // Allocator accounting to the given subsystem, to be passed to rcl/rclc init functions.
+  rcutils_allocator_t allocator(MemorySubsystem subsystem);
+
+  Stats stats() const;
+  std::string dump() const;
+
+ private:
+  explicit PoolAllocator(size_t arenaSize);
+
+  // Blocks of 32 bytes up to 16 KiB.
+  static constexpr size_t kSizeClasses = 10;
+
+  struct Tag {
+    PoolAllocator* pool;
+    MemorySubsystem subsystem;
+  };
+
+  void* allocate(size_t size, MemorySubsystem subsystem);
+  void deallocate(void* pointer);
+  void* reallocate(void* pointer, size_t size, MemorySubsystem subsystem);
+
+  static void* allocateCallback(size_t size, void* state);
+  static void deallocateCallback(void* pointer, void* state);
+  static void* reallocateCallback(void* pointer, size_t size, void* state);
+  static void* zeroAllocateCallback(size_t count, size_t size, void* state);
+
+  mutable std::mutex m_lock;
+  std::unique_ptr<uint8_t[]> m_arena;
+  const size_t m_arenaSize;
+  size_t m_arenaUsed = 0;
+  uint64_t m_overflows = 0;
+  // Singly linked through the first bytes of each free block.
+  std::array<void*, kSizeClasses> m_freeLists{};
+  std::array<SubsystemStats, static_cast<size_t>(MemorySubsystem::COUNT)> m_subsystems;
+  std::array<Tag, static_cast<size_t>(MemorySubsystem::COUNT)> m_tags;
+};
+
+}  // namespace vendor::spyrosoft::vehicle::ros2
@@ -0,0 +1,369 @@
+/*
+ * Copyright (c) 2023 Spyrosoft Synergy S.A.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "Ros2PropertyCodec.h"
+
+#include <VehicleUtils.h>
+#include <rosidl_runtime_c/primitives_sequence_functions.h>
+#include <rosidl_runtime_c/string_functions.h>
+
+#include <algorithm>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace vendor::spyrosoft::vehicle::ros2 {
+
+using aidl::android::hardware::automotive::vehicle::VehiclePropertyType;
+using aidl::android::hardware::automotive::vehicle::VehiclePropValue;
+
+namespace {
+
+bool init_sequence(rosidl_runtime_c__int32__Sequence& seq, size_t size)
+{
+  return rosidl_runtime_c__int32__Sequence__init(&seq, size);
+}
+
+bool init_sequence(rosidl_runtime_c__int64__Sequence& seq, size_t size)
+{
+  return rosidl_runtime_c__int64__Sequence__init(&seq, size);
+}
+
+bool init_sequence(rosidl_runtime_c__float__Sequence& seq, size_t size)
+{
+  return rosidl_runtime_c__float__Sequence__init(&seq, size);
+}
+
+bool init_sequence(rosidl_runtime_c__uint8__Sequence& seq, size_t size)
+{
+  return rosidl_runtime_c__uint8__Sequence__init(&seq, size);
+}
+
+// Scalar types carry exactly one element, vector types any number of them.
+template <bool Scalar, typename T, typename Sequence>
+bool encode_values(const std::vector<T>& values, Sequence& seq)
+{
+  if constexpr (Scalar) {
+    if (values.empty()) {
+      return false;
+    }
+  }
+
+  const size_t size = Scalar ? 1 : values.size();
+  if (size == 0) {
+    return true;
+  }
+  if (!init_sequence(seq, size)) {
+    return false;
+  }
+  std::copy_n(values.data(), size, seq.data);
+  return true;
+}
+
+template <typename T, typename Sequence>
+void decode_values(const Sequence& seq, std::vector<T>& values)
+{
+  values.assign(seq.data, seq.data + seq.size);
+}
+
+}  // namespace
+
+template <VehiclePropertyType Type>
+bool PropertyCodec<Type>::encode(const VehiclePropValue& value, ros2_android_vhal__msg__VehicleProperty& msg)
+{
+  if constexpr (Traits::kInt32) {
+    if (!encode_values<Traits::kScalar>(value.value.int32Values, msg.int32_values)) {
+      return false;
+    }
+  }
+  if constexpr (Traits::kInt64) {
+    if (!encode_values<Traits::kScalar>(value.value.int64Values, msg.int64_values)) {
+      return false;
+    }
+  }
+  if constexpr (Traits::kFloat) {
+    if (!encode_values<Traits::kScalar>(value.value.floatValues, msg.float_values)) {
+      return false;
+    }
+  }
+  if constexpr (Traits::kBytes) {
+    if (!encode_values<Traits::kScalar>(value.value.byteValues, msg.uint8_values)) {
+      return false;
+    }
+  }
+  if constexpr (Traits::kString) {
+    // STRING always carries its string, even an empty one, MIXED only when it is set.
+    if (Type == VehiclePropertyType::STRING || !value.value.stringValue.empty()) {
+      if (!rosidl_runtime_c__String__Sequence__init(&msg.string_values, 1) ||
+          !rosidl_runtime_c__String__assignn(&msg.string_values.data[0], value.value.stringValue.data(),
+                                             value.value.stringValue.size())) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+template <VehiclePropertyType Type>
+void PropertyCodec<Type>::decode(const ros2_android_vhal__msg__VehicleProperty& msg, VehiclePropValue& value)
+{
+  if constexpr (Traits::kInt32) {
+    decode_values(msg.int32_values, value.value.int32Values);
+  }
+  if constexpr (Traits::kInt64) {
+    decode_values(msg.int64_values, value.value.int64Values);
+  }
+  if constexpr (Traits::kFloat) {
+    decode_values(msg.float_values, value.value.floatValues);
+  }
+  if constexpr (Traits::kBytes) {
+    decode_values(msg.uint8_values, value.value.byteValues);
+  }
+  if constexpr (Traits::kString) {
+    if (msg.string_values.size > 0) {
+      value.value.stringValue.assign(msg.string_values.data[0].data, msg.string_values.data[0].size);
+    }
+  }
+}
+
+namespace {
+
+// Calls handler with the codec of the property type, MIXED stands in for unknown types.
+template <typename Handler>
+auto dispatch(int32_t propId, Handler&& handler)
+{
+  switch (android::hardware::automotive::vehicle::getPropType(propId)) {
+    case VehiclePropertyType::STRING:
+      return handler(PropertyCodec<VehiclePropertyType::STRING>{});
+    case VehiclePropertyType::BOOLEAN:
+      return handler(PropertyCodec<VehiclePropertyType::BOOLEAN>{});
+    case VehiclePropertyType::INT32:
+      return handler(PropertyCodec<VehiclePropertyType::INT32>{});
+    case VehiclePropertyType::INT32_VEC:
+      return handler(PropertyCodec<VehiclePropertyType::INT32_VEC>{});
+    case VehiclePropertyType::INT64:
+      return handler(PropertyCodec<VehiclePropertyType::INT64>{});
+    case VehiclePropertyType::INT64_VEC:
+      return handler(PropertyCodec<VehiclePropertyType::INT64_VEC>{});
+    case VehiclePropertyType::FLOAT:
+      return handler(PropertyCodec<VehiclePropertyType::FLOAT>{});
+    case VehiclePropertyType::FLOAT_VEC:
+      return handler(PropertyCodec<VehiclePropertyType::FLOAT_VEC>{});
+    case VehiclePropertyType::BYTES:
+      return handler(PropertyCodec<VehiclePropertyType::BYTES>{});
+    default:
+      return handler(PropertyCodec<VehiclePropertyType::MIXED>{});
+  }
+}
+
+}  // namespace
+
+bool encodeProperty(const VehiclePropValue& value, ros2_android_vhal__msg__VehicleProperty& msg)
+{
+  msg.timestamp = value.timestamp;
+  msg.area_id = value.areaId;
+  msg.prop_id = value.prop;
+  return dispatch(value.prop, [&](auto codec) { return decltype(codec)::encode(value, msg); });
+}
+
+VehiclePropValue decodeProperty(const ros2_android_vhal__msg__VehicleProperty& msg)
+{
+  VehiclePropValue value;
+  value.timestamp = msg.timestamp;
+  value.areaId = msg.area_id;
+  value.prop = msg.prop_id;
+  dispatch(msg.prop_id, [&](auto codec) { decltype(codec)::decode(msg, value); });
+  return value;
+}
+
+bool isEncodable(const VehiclePropValue& value)
+{
+  return dispatch(value.prop, [&](auto codec) {
+    using Traits = typename decltype(codec)::Traits;
+    if constexpr (Traits::kScalar) {
+      return (Traits::kInt32 && !value.value.int32Values.empty()) ||
+             (Traits::kInt64 && !value.value.int64Values.empty()) ||
+             (Traits::kFloat && !value.value.floatValues.empty());
+    }
+    else {
+      return true;
+    }
+  });
+}
+
+namespace {
+
+// Field of a scalar type in the message and in the value, and where a batch keeps its area ids.
+template <VehiclePropertyType Type>
+struct ZonedBatchLayout {
+  using Traits = PropertyTypeTraits<Type>;
+  static_assert(Traits::kScalar);
+
+  static auto& values(ros2_android_vhal__msg__VehicleProperty& msg)
+  {
+    if constexpr (Traits::kInt32) {
+      return msg.int32_values;
+    }
+    else if constexpr (Traits::kInt64) {
+      return msg.int64_values;
+    }
+    else {
+      return msg.float_values;
+    }
+  }
+
+  static const auto& values(const ros2_android_vhal__msg__VehicleProperty& msg)
+  {
+    return values(const_cast<ros2_android_vhal__msg__VehicleProperty&>(msg));
+  }
+
+  static auto& values(VehiclePropValue& value)
+  {
+    if constexpr (Traits::kInt32) {
+      return value.value.int32Values;
+    }
+    else if constexpr (Traits::kInt64) {
+      return value.value.int64Values;
+    }
+    else {
+      return value.value.floatValues;
+    }
+  }
+
+  static const auto& values(const VehiclePropValue& value) { return values(const_cast<VehiclePropValue&>(value)); }
+
+  static auto& areas(ros2_android_vhal__msg__VehicleProperty& msg)
+  {
+    if constexpr (Traits::kInt64) {
+      return msg.int32_values;
+    }
+    else {
+      return msg.int64_values;
+    }
+  }
+
+  static const auto& areas(const ros2_android_vhal__msg__VehicleProperty& msg)
+  {
+    return areas(const_cast<ros2_android_vhal__msg__VehicleProperty&>(msg));
+  }
+};
+
+template <VehiclePropertyType Type>
+bool encode_zoned_batch(const std::vector<const VehiclePropValue*>& values, ros2_android_vhal__msg__VehicleProperty& msg)
+{
+  using Layout = ZonedBatchLayout<Type>;
+  auto& areaSeq = Layout::areas(msg);
+  auto& valueSeq = Layout::values(msg);
+  if (!init_sequence(areaSeq, values.size()) || !init_sequence(valueSeq, values.size())) {
+    return false;
+  }
+
+  for (size_t i = 0; i < values.size(); i++) {
+    const auto& source = Layout::values(*values[i]);
+    if (source.empty()) {
+      return false;
+    }
+    areaSeq.data[i] = values[i]->areaId;
+    valueSeq.data[i] = source[0];
+    msg.timestamp = std::max(msg.timestamp, values[i]->timestamp);
+  }
+  return true;
+}
+
+template <VehiclePropertyType Type>
+std::vector<VehiclePropValue> decode_zoned_batch(const ros2_android_vhal__msg__VehicleProperty& msg)
+{
+  using Layout = ZonedBatchLayout<Type>;
+  const auto& areaSeq = Layout::areas(msg);
+  const auto& valueSeq = Layout::values(msg);
+  if (areaSeq.size == 0 || areaSeq.size != valueSeq.size || areaSeq.data == nullptr || valueSeq.data == nullptr) {
+    return {};
+  }
+
+  std::vector<VehiclePropValue> values(areaSeq.size);
+  for (size_t i = 0; i < areaSeq.size; i++) {
+    values[i].timestamp = msg.timestamp;
+    values[i].areaId = static_cast<int32_t>(areaSeq.data[i]);
+    values[i].prop = msg.prop_id;
+    Layout::values(values[i]).assign(1, valueSeq.data[i]);
+  }
+  return values;
+}
+
+// Calls handler with the type of a batchable property, returns fallback for the others.
+template <typename Handler, typename Result>
+Result dispatch_zoned(int32_t propId, Handler&& handler, Result fallback)
+{
+  switch (android::hardware::automotive::vehicle::getPropType(propId)) {
+    case VehiclePropertyType::BOOLEAN:
+      return handler(std::integral_constant<VehiclePropertyType, VehiclePropertyType::BOOLEAN>{});
+    case VehiclePropertyType::INT32:
+      return handler(std::integral_constant<VehiclePropertyType, VehiclePropertyType::INT32>{});
+    case VehiclePropertyType::INT64:
+      return handler(std::integral_constant<VehiclePropertyType, VehiclePropertyType::INT64>{});
+    case VehiclePropertyType::FLOAT:
+      return handler(std::integral_constant<VehiclePropertyType, VehiclePropertyType::FLOAT>{});
+    default:
+      return fallback;
+  }
+}
+
+}  // namespace
+
+bool isBatchable(int32_t propId)
+{
+  return !android::hardware::automotive::vehicle::isGlobalProp(propId) &&
+         dispatch_zoned(propId, [](auto) { return true; }, false);
+}
+
+bool isZonedBatch(const ros2_android_vhal__msg__VehicleProperty& msg)
+{
+  return msg.string_values.size == 1 && msg.string_values.data != nullptr &&
+         std::string_view(msg.string_values.data[0].data, msg.string_values.data[0].size) == kZonedBatchTag &&
+         isBatchable(msg.prop_id);
+}
+
+bool encodeZonedBatch(const std::vector<const VehiclePropValue*>& values, ros2_android_vhal__msg__VehicleProperty& msg)
+{
+  if (values.empty()) {
+    return false;
+  }
+
+  msg.area_id = kZonedBatchAreaId;
+  msg.prop_id = values[0]->prop;
+  msg.timestamp = 0;
+  if (!rosidl_runtime_c__String__Sequence__init(&msg.string_values, 1) ||
+      !rosidl_runtime_c__String__assignn(&msg.string_values.data[0], kZonedBatchTag.data(), kZonedBatchTag.size())) {
+    return false;
+  }
+  return dispatch_zoned(
+      msg.prop_id, [&](auto type) { return encode_zoned_batch<decltype(type)::value>(values, msg); }, false);
+}
+
+std::vector<VehiclePropValue> decodeZonedBatch(const ros2_android_vhal__msg__VehicleProperty& msg)
+{
+  return dispatch_zoned(
+      msg.prop_id, [&](auto type) { return decode_zoned_batch<decltype(type)::value>(msg); },
+      std::vector<VehiclePropValue>{});
+}
+
+}  // namespace vendor::spyrosoft::vehicle::ros2
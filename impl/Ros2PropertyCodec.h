@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2023 Spyrosoft Synergy S.A.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <aidl/android/hardware/automotive/vehicle/VehiclePropValue.h>
+#include <aidl/android/hardware/automotive/vehicle/VehiclePropertyType.h>
+#include <ros2_android_vhal/msg/vehicle_property.h>
+
+#include <string_view>
+#include <vector>
+
+namespace vendor::spyrosoft::vehicle::ros2 {
+
+/**
+ * @brief Value fields a VehiclePropertyType carries, and whether they hold one element or all of them.
+ *
+ * The property type is part of the property id, so the layout of a value is known before looking
+ * at its contents. The primary template describes MIXED, which may use every field.
+ */
+template <aidl::android::hardware::automotive::vehicle::VehiclePropertyType Type>
+struct PropertyTypeTraits {
+  static constexpr bool kInt32 = true;
+  static constexpr bool kInt64 = true;
+  static constexpr bool kFloat = true;
+  static constexpr bool kBytes = true;
+  static constexpr bool kString = true;
+  static constexpr bool kScalar = false;
+};
+
+namespace detail {
+
+template <bool Int32, bool Int64, bool Float, bool Bytes, bool String, bool Scalar>
+struct PropertyLayout {
+  static constexpr bool kInt32 = Int32;
+  static constexpr bool kInt64 = Int64;
+  static constexpr bool kFloat = Float;
+  static constexpr bool kBytes = Bytes;
+  static constexpr bool kString = String;
+  static constexpr bool kScalar = Scalar;
+};
+
+}  // namespace detail
+
+// clang-format off
+template <> struct PropertyTypeTraits<aidl::android::hardware::automotive::vehicle::VehiclePropertyType::STRING>
+    : detail::PropertyLayout<false, false, false, false, true, false> {};
+template <> struct PropertyTypeTraits<aidl::android::hardware::automotive::vehicle::VehiclePropertyType::BOOLEAN>
+    : detail::PropertyLayout<true, false, false, false, false, true> {};
+template <> struct PropertyTypeTraits<aidl::android::hardware::automotive::vehicle::VehiclePropertyType::INT32>
+    : detail::PropertyLayout<true, false, false, false, false, true> {};
+template <> struct PropertyTypeTraits<aidl::android::hardware::automotive::vehicle::VehiclePropertyType::INT32_VEC>
+    : detail::PropertyLayout<true, false, false, false, false, false> {};
+template <> struct PropertyTypeTraits<aidl::android::hardware::automotive::vehicle::VehiclePropertyType::INT64>
+    : detail::PropertyLayout<false, true, false, false, false, true> {};
+template <> struct PropertyTypeTraits<aidl::android::hardware::automotive::vehicle::VehiclePropertyType::INT64_VEC>
+    : detail::PropertyLayout<false, true, false, false, false, false> {};
+template <> struct PropertyTypeTraits<aidl::android::hardware::automotive::vehicle::VehiclePropertyType::FLOAT>
+    : detail::PropertyLayout<false, false, true, false, false, true> {};
+template <> struct PropertyTypeTraits<aidl::android::hardware::automotive::vehicle::VehiclePropertyType::FLOAT_VEC>
+    : detail::PropertyLayout<false, false, true, false, false, false> {};
+template <> struct PropertyTypeTraits<aidl::android::hardware::automotive::vehicle::VehiclePropertyType::BYTES>
+    : detail::PropertyLayout<false, false, false, true, false, false> {};
+// clang-format on
+
+/**
+ * @brief Encoder and decoder of a single VehiclePropertyType.
+ *
+ * Only the fields of the type are touched. Encoding copies straight from the VehiclePropValue into
+ * the message sequences, there is no intermediate representation.
+ */
+template <aidl::android::hardware::automotive::vehicle::VehiclePropertyType Type>
+struct PropertyCodec {
+  using Traits = PropertyTypeTraits<Type>;
+
+  // Fills msg, which must be zero initialized, false when the value is malformed for its type or
+  // the message memory could not be allocated.
+  static bool encode(const aidl::android::hardware::automotive::vehicle::VehiclePropValue& value,
+                     ros2_android_vhal__msg__VehicleProperty& msg);
+
+  static void decode(const ros2_android_vhal__msg__VehicleProperty& msg,
+                     aidl::android::hardware::automotive::vehicle::VehiclePropValue& value);
+};
+
+// Encodes value into msg with the codec of its property type. msg must be zero initialized and is
+// left for the caller to fini, also on failure.
+bool encodeProperty(const aidl::android::hardware::automotive::vehicle::VehiclePropValue& value,
+                    ros2_android_vhal__msg__VehicleProperty& msg);
+
+// Decodes msg with the codec of its property type, fields of other types are ignored.
+aidl::android::hardware::automotive::vehicle::VehiclePropValue decodeProperty(
+    const ros2_android_vhal__msg__VehicleProperty& msg);
+
+// Whether value carries what its property type requires, encodeProperty() accepts it then.
+bool isEncodable(const aidl::android::hardware::automotive::vehicle::VehiclePropValue& value);
+
+/*
+ * Zoned batches carry several areas of one zoned property in a single message. Only scalar types
+ * (BOOLEAN, INT32, INT64, FLOAT) are batched. A batch is flagged by kZonedBatchTag as its only
+ * string, which a sample of a scalar type never carries, and holds one value per area in the field
+ * of its type, with the matching area ids in int64_values, or in int32_values for INT64 properties:
+ *
+ *   area_id = 0, string_values = {"zoned_batch"},
+ *   int64_values = {area0, area1, ...}, int32_values = {value0, value1, ...}
+ */
+constexpr std::string_view kZonedBatchTag = "zoned_batch";
+constexpr int32_t kZonedBatchAreaId = 0;
+
+bool isBatchable(int32_t propId);
+bool isZonedBatch(const ros2_android_vhal__msg__VehicleProperty& msg);
+
+// Encodes values, all of the same batchable property, into msg, which must be zero initialized.
+// The batch is stamped with the latest timestamp of the values.
+bool encodeZonedBatch(const std::vector<const aidl::android::hardware::automotive::vehicle::VehiclePropValue*>& values,
+                      ros2_android_vhal__msg__VehicleProperty& msg);
+
+// One value per area of the batch, empty when the batch is malformed: no areas, or not as many
+// values as areas.
+std::vector<aidl::android::hardware::automotive::vehicle::VehiclePropValue> decodeZonedBatch(
+    const ros2_android_vhal__msg__VehicleProperty& msg);
+
+}  // namespace vendor::spyrosoft::vehicle::ros2
@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2023 Spyrosoft Synergy S.A.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "Ros2PropertyDomain.h"
+
+namespace vendor::spyrosoft::vehicle {
+
+PropertyDomain getPropertyDomain(int32_t propId)
+{
+  const int32_t id = propId & 0xffff;
+
+  // PERF_*, ENGINE_*, GEAR_*, fuel and EV charge port.
+  if (id >= 0x0200 && id < 0x0500) {
+    return PropertyDomain::POWERTRAIN;
+  }
+  // EV_CHARGE_* and EV_REGENERATIVE_BRAKING_STATE, numbered among the body ids.
+  if (id >= 0x0f3f && id <= 0x0f44) {
+    return PropertyDomain::POWERTRAIN;
+  }
+  // HVAC_*.
+  if (id >= 0x0500 && id < 0x0600) {
+    return PropertyDomain::HVAC;
+  }
+  // DOOR_*, MIRROR_*, SEAT_*, WINDOW_*, lights and the rest of the cabin.
+  if (id >= 0x0a00 && id < 0x1000) {
+    return PropertyDomain::BODY;
+  }
+  return PropertyDomain::OTHER;
+}
+
+const char* toString(PropertyDomain domain)
+{
+  switch (domain) {
+    case PropertyDomain::POWERTRAIN:
+      return "powertrain";
+    case PropertyDomain::BODY:
+      return "body";
+    case PropertyDomain::HVAC:
+      return "hvac";
+    default:
+      return "other";
+  }
+}
+
+std::optional<PropertyDomain> parsePropertyDomain(const std::string& name)
+{
+  for (const auto domain :
+       {PropertyDomain::OTHER, PropertyDomain::POWERTRAIN, PropertyDomain::BODY, PropertyDomain::HVAC}) {
+    if (name == toString(domain)) {
+      return domain;
+    }
+  }
+  return std::nullopt;
+}
+
+}  // namespace vendor::spyrosoft::vehicle
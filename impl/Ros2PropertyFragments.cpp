@@ -0,0 +1,169 @@
+/*
+ * Copyright (c) 2023 Spyrosoft Synergy S.A.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "Ros2PropertyFragments.h"
+
+#include <algorithm>
+
+#include "common/logging.hpp"
+
+namespace vendor::spyrosoft::vehicle::ros2 {
+
+using aidl::android::hardware::automotive::vehicle::VehiclePropertyType;
+using aidl::android::hardware::automotive::vehicle::VehiclePropValue;
+using android::hardware::automotive::vehicle::PropIdAreaId;
+
+namespace {
+
+constexpr size_t kFragmentHeaderSize = 3;
+
+// A transfer that received no fragment for this long is abandoned.
+constexpr int64_t kTransferTimeoutNs = 5'000'000'000;
+
+bool is_payload_type(int32_t propId)
+{
+  const auto type = android::hardware::automotive::vehicle::getPropType(propId);
+  return type == VehiclePropertyType::STRING || type == VehiclePropertyType::BYTES;
+}
+
+// Payload of a STRING or BYTES value, without copying it.
+std::pair<const uint8_t*, size_t> payload_of(const VehiclePropValue& value)
+{
+  if (android::hardware::automotive::vehicle::getPropType(value.prop) == VehiclePropertyType::STRING) {
+    return {reinterpret_cast<const uint8_t*>(value.value.stringValue.data()), value.value.stringValue.size()};
+  }
+  return {value.value.byteValues.data(), value.value.byteValues.size()};
+}
+
+}  // namespace
+
+bool needsFragmentation(const VehiclePropValue& value)
+{
+  return is_payload_type(value.prop) && payload_of(value).second > kMaxFragmentPayload;
+}
+
+bool isFragment(const ros2_android_vhal__msg__VehicleProperty& msg)
+{
+  return is_payload_type(msg.prop_id) && msg.int64_values.size == kFragmentHeaderSize;
+}
+
+PropertyFragment::PropertyFragment(const VehiclePropValue& value, int64_t transferId, size_t offset) : m_msg{}
+{
+  const auto [data, size] = payload_of(value);
+  const size_t length = std::min(kMaxFragmentPayload, size - std::min(offset, size));
+
+  m_header[0] = transferId;
+  m_header[1] = static_cast<int64_t>(offset);
+  m_header[2] = static_cast<int64_t>(size);
+
+  m_msg.timestamp = value.timestamp;
+  m_msg.area_id = value.areaId;
+  m_msg.prop_id = value.prop;
+  m_msg.int64_values = {m_header, kFragmentHeaderSize, kFragmentHeaderSize};
+  // Serialization only reads from the sequences.
+  m_msg.uint8_values = {const_cast<uint8_t*>(data) + offset, length, length};
+}
+
+std::optional<VehiclePropValue> FragmentAssembler::add(const ros2_android_vhal__msg__VehicleProperty& msg,
+                                                       int64_t nowNs)
+{
+  expire(nowNs);
+
+  const int64_t transferId = msg.int64_values.data[0];
+  const int64_t offset = msg.int64_values.data[1];
+  const int64_t totalSize = msg.int64_values.data[2];
+  if (totalSize < 0 || static_cast<size_t>(totalSize) > kMaxTransferSize) {
+    ALOGW("FragmentAssembler - property %d transfer of %lld bytes rejected", msg.prop_id,
+          static_cast<long long>(totalSize));
+    m_dropped++;
+    return std::nullopt;
+  }
+
+  const PropIdAreaId key{.propId = msg.prop_id, .areaId = msg.area_id};
+  auto it = m_transfers.find(key);
+  if (it != m_transfers.end() && it->second.transferId != transferId) {
+    m_transfers.erase(it);
+    m_dropped++;
+    it = m_transfers.end();
+  }
+
+  if (it == m_transfers.end()) {
+    if (offset != 0) {
+      // The start of this transfer was lost, nothing to build on.
+      m_dropped++;
+      return std::nullopt;
+    }
+    Transfer transfer{.transferId = transferId, .timestamp = msg.timestamp, .lastFragmentNs = nowNs, .data = {}};
+    transfer.data.reserve(static_cast<size_t>(totalSize));
+    it = m_transfers.emplace(key, std::move(transfer)).first;
+  }
+
+  Transfer& transfer = it->second;
+  if (static_cast<size_t>(offset) != transfer.data.size() ||
+      transfer.data.size() + msg.uint8_values.size > static_cast<size_t>(totalSize)) {
+    ALOGW("FragmentAssembler - property %d fragment at %lld out of order", msg.prop_id,
+          static_cast<long long>(offset));
+    m_transfers.erase(it);
+    m_dropped++;
+    return std::nullopt;
+  }
+
+  transfer.data.insert(transfer.data.end(), msg.uint8_values.data, msg.uint8_values.data + msg.uint8_values.size);
+  transfer.lastFragmentNs = nowNs;
+  if (transfer.data.size() < static_cast<size_t>(totalSize)) {
+    return std::nullopt;
+  }
+
+  VehiclePropValue value;
+  value.timestamp = transfer.timestamp;
+  value.areaId = msg.area_id;
+  value.prop = msg.prop_id;
+  if (android::hardware::automotive::vehicle::getPropType(msg.prop_id) == VehiclePropertyType::STRING) {
+    value.value.stringValue.assign(transfer.data.begin(), transfer.data.end());
+  }
+  else {
+    value.value.byteValues = std::move(transfer.data);
+  }
+  m_transfers.erase(it);
+  return value;
+}
+
+void FragmentAssembler::clear()
+{
+  m_dropped += m_transfers.size();
+  m_transfers.clear();
+}
+
+void FragmentAssembler::expire(int64_t nowNs)
+{
+  for (auto it = m_transfers.begin(); it != m_transfers.end();) {
+    if (nowNs - it->second.lastFragmentNs > kTransferTimeoutNs) {
+      it = m_transfers.erase(it);
+      m_dropped++;
+    }
+    else {
+      ++it;
+    }
+  }
+}
+
+}  // namespace vendor::spyrosoft::vehicle::ros2
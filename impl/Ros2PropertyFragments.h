@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2023 Spyrosoft Synergy S.A.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <VehicleUtils.h>
+#include <aidl/android/hardware/automotive/vehicle/VehiclePropValue.h>
+#include <ros2_android_vhal/msg/vehicle_property.h>
+
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+namespace vendor::spyrosoft::vehicle::ros2 {
+
+/*
+ * STRING and BYTES values larger than kMaxFragmentPayload do not fit a single XRCE message, they
+ * are split into fragments of the same property. A fragment carries its slice of the payload in
+ * uint8_values, also for STRING properties, and a header in int64_values, which neither type
+ * uses otherwise:
+ *
+ *   int64_values = {transferId, offset, totalSize}
+ *
+ * Fragments of a transfer are sent in order on a reliable stream.
+ */
+
+// Payload bytes of a single message, leaves room for the message header within the default
+// 512 byte XRCE MTU.
+constexpr size_t kMaxFragmentPayload = 384;
+
+// Largest value accepted for reassembly.
+constexpr size_t kMaxTransferSize = 1024 * 1024;
+
+// Whether value is a STRING or BYTES value too large for a single message.
+bool needsFragmentation(const aidl::android::hardware::automotive::vehicle::VehiclePropValue& value);
+
+// Whether msg is a fragment of a larger value.
+bool isFragment(const ros2_android_vhal__msg__VehicleProperty& msg);
+
+/**
+ * @brief Fragment message borrowing its payload from the value being sent.
+ *
+ * The message sequences point into the VehiclePropValue and the fragment itself, so nothing is
+ * copied before serialization. Both must outlive the send, the message is never fini'd.
+ */
+class PropertyFragment {
+ public:
+  PropertyFragment(const aidl::android::hardware::automotive::vehicle::VehiclePropValue& value, int64_t transferId,
+                   size_t offset);
+
+  PropertyFragment(const PropertyFragment&) = delete;
+  PropertyFragment& operator=(const PropertyFragment&) = delete;
+
+  const ros2_android_vhal__msg__VehicleProperty& msg() const { return m_msg; }
+  // Payload bytes of this fragment, the next one starts at offset + size().
+  size_t size() const { return m_msg.uint8_values.size; }
+  size_t totalSize() const { return static_cast<size_t>(m_header[2]); }
+
+ private:
+  int64_t m_header[3];
+  ros2_android_vhal__msg__VehicleProperty m_msg;
+};
+
+/**
+ * @brief Reassembles fragmented values, one transfer per property and area at a time.
+ *
+ * A fragment out of order, or of a newer transfer, abandons the transfer in progress. Transfers
+ * that stop receiving fragments are dropped after a timeout.
+ */
+class FragmentAssembler {
+ public:
+  // Adds a fragment, returns the value once its last fragment arrived.
+  std::optional<aidl::android::hardware::automotive::vehicle::VehiclePropValue> add(
+      const ros2_android_vhal__msg__VehicleProperty& msg, int64_t nowNs);
+
+  void clear();
+
+  uint64_t dropped() const { return m_dropped; }
+
+ private:
+  struct Transfer {
+    int64_t transferId;
+    int64_t timestamp;
+    int64_t lastFragmentNs;
+    std::vector<uint8_t> data;
+  };
+
+  void expire(int64_t nowNs);
+
+  std::unordered_map<android::hardware::automotive::vehicle::PropIdAreaId, Transfer,
+                     android::hardware::automotive::vehicle::PropIdAreaIdHash>
+      m_transfers;
+  // Read by other threads for statistics.
+  std::atomic_uint64_t m_dropped{0};
+};
+
+}  // namespace vendor::spyrosoft::vehicle::ros2
@@ -0,0 +1,253 @@
+/*
+ * Copyright (c) 2023 Spyrosoft Synergy S.A.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "Ros2PropertySnapshot.h"
+
+#include <android-base/file.h>
+#include <android-base/unique_fd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstring>
+
+#include "common/logging.hpp"
+
+namespace vendor::spyrosoft::vehicle {
+
+using aidl::android::hardware::automotive::vehicle::VehiclePropertyStatus;
+using aidl::android::hardware::automotive::vehicle::VehiclePropValue;
+using android::hardware::automotive::vehicle::VehiclePropValuePool;
+
+namespace {
+
+constexpr uint32_t kSnapshotMagic = 0x56535232;  // "VSR2"
+constexpr uint32_t kSnapshotVersion = 1;
+
+struct SnapshotHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t recordCount;
+  uint32_t payloadSize;
+  uint64_t checksum;
+};
+
+// Payload layout of a record: int64 values, int32 values, float values, bytes, string.
+struct SnapshotRecord {
+  int32_t prop;
+  int32_t areaId;
+  int64_t timestamp;
+  int32_t status;
+  uint32_t payloadOffset;
+  uint32_t int64Count;
+  uint32_t int32Count;
+  uint32_t floatCount;
+  uint32_t byteCount;
+  uint32_t stringSize;
+  uint32_t reserved;
+};
+
+static_assert(sizeof(SnapshotHeader) == 24);
+static_assert(sizeof(SnapshotRecord) == 48);
+
+// FNV-1a, only used to reject torn or foreign files.
+uint64_t checksum(const uint8_t* data, size_t size)
+{
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (size_t i = 0; i < size; i++) {
+    hash = (hash ^ data[i]) * 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+size_t alignTo8(size_t size) { return (size + 7) & ~static_cast<size_t>(7); }
+
+template <class T>
+void append(std::vector<uint8_t>& buffer, const T* data, size_t count)
+{
+  const auto* bytes = reinterpret_cast<const uint8_t*>(data);
+  buffer.insert(buffer.end(), bytes, bytes + count * sizeof(T));
+}
+
+template <class T>
+std::vector<T> readArray(const uint8_t*& cursor, uint32_t count)
+{
+  std::vector<T> values(count);
+  std::memcpy(values.data(), cursor, count * sizeof(T));
+  cursor += count * sizeof(T);
+  return values;
+}
+
+}  // namespace
+
+PropertySnapshot::PropertySnapshot(std::string path) : mPath(std::move(path)) {}
+
+bool PropertySnapshot::save(const std::vector<VehiclePropValuePool::RecyclableType>& values)
+{
+  std::vector<SnapshotRecord> records;
+  records.reserve(values.size());
+  std::vector<uint8_t> payload;
+
+  for (const auto& value : values) {
+    const auto& raw = value->value;
+    records.push_back({
+        .prop = value->prop,
+        .areaId = value->areaId,
+        .timestamp = value->timestamp,
+        .status = static_cast<int32_t>(value->status),
+        .payloadOffset = static_cast<uint32_t>(payload.size()),
+        .int64Count = static_cast<uint32_t>(raw.int64Values.size()),
+        .int32Count = static_cast<uint32_t>(raw.int32Values.size()),
+        .floatCount = static_cast<uint32_t>(raw.floatValues.size()),
+        .byteCount = static_cast<uint32_t>(raw.byteValues.size()),
+        .stringSize = static_cast<uint32_t>(raw.stringValue.size()),
+        .reserved = 0,
+    });
+    append(payload, raw.int64Values.data(), raw.int64Values.size());
+    append(payload, raw.int32Values.data(), raw.int32Values.size());
+    append(payload, raw.floatValues.data(), raw.floatValues.size());
+    append(payload, raw.byteValues.data(), raw.byteValues.size());
+    append(payload, raw.stringValue.data(), raw.stringValue.size());
+    payload.resize(alignTo8(payload.size()));
+  }
+
+  std::vector<uint8_t> body;
+  body.reserve(records.size() * sizeof(SnapshotRecord) + payload.size());
+  append(body, records.data(), records.size());
+  append(body, payload.data(), payload.size());
+
+  const SnapshotHeader header = {
+      .magic = kSnapshotMagic,
+      .version = kSnapshotVersion,
+      .recordCount = static_cast<uint32_t>(records.size()),
+      .payloadSize = static_cast<uint32_t>(payload.size()),
+      .checksum = checksum(body.data(), body.size()),
+  };
+
+  const std::string tmpPath = mPath + ".tmp";
+  android::base::unique_fd fd(TEMP_FAILURE_RETRY(open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600)));
+  if (fd == -1) {
+    ALOGE("PropertySnapshot - failed to open %s: %s", tmpPath.c_str(), strerror(errno));
+    return false;
+  }
+
+  if (!android::base::WriteFully(fd, &header, sizeof(header)) || !android::base::WriteFully(fd, body.data(), body.size()) ||
+      fsync(fd) != 0) {
+    ALOGE("PropertySnapshot - failed to write %s: %s", tmpPath.c_str(), strerror(errno));
+    unlink(tmpPath.c_str());
+    return false;
+  }
+  fd.reset();
+
+  if (rename(tmpPath.c_str(), mPath.c_str()) != 0) {
+    ALOGE("PropertySnapshot - failed to rename %s: %s", tmpPath.c_str(), strerror(errno));
+    unlink(tmpPath.c_str());
+    return false;
+  }
+
+  // Persist the rename itself.
+  android::base::unique_fd dirFd(
+      TEMP_FAILURE_RETRY(open(android::base::Dirname(mPath).c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC)));
+  if (dirFd != -1) {
+    fsync(dirFd);
+  }
+
+  ALOGD("PropertySnapshot - saved %zu values", records.size());
+  return true;
+}
+
+bool PropertySnapshot::isStorageReady() const
+{
+  return access(android::base::Dirname(mPath).c_str(), W_OK) == 0;
+}
+
+std::vector<VehiclePropValue> PropertySnapshot::load() const
+{
+  std::vector<VehiclePropValue> values;
+
+  android::base::unique_fd fd(TEMP_FAILURE_RETRY(open(mPath.c_str(), O_RDONLY | O_CLOEXEC)));
+  if (fd == -1) {
+    ALOGI("PropertySnapshot - no snapshot at %s", mPath.c_str());
+    return values;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(SnapshotHeader)) {
+    ALOGW("PropertySnapshot - %s is truncated", mPath.c_str());
+    return values;
+  }
+
+  const size_t size = static_cast<size_t>(st.st_size);
+  void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (mapping == MAP_FAILED) {
+    ALOGE("PropertySnapshot - failed to map %s: %s", mPath.c_str(), strerror(errno));
+    return values;
+  }
+
+  const auto* base = static_cast<const uint8_t*>(mapping);
+  const auto* header = reinterpret_cast<const SnapshotHeader*>(base);
+  const size_t bodySize = size - sizeof(SnapshotHeader);
+  const size_t recordsSize = static_cast<size_t>(header->recordCount) * sizeof(SnapshotRecord);
+
+  if (header->magic != kSnapshotMagic || header->version != kSnapshotVersion ||
+      recordsSize + header->payloadSize != bodySize ||
+      header->checksum != checksum(base + sizeof(SnapshotHeader), bodySize)) {
+    ALOGW("PropertySnapshot - %s is invalid, ignoring it", mPath.c_str());
+    munmap(mapping, size);
+    return values;
+  }
+
+  const auto* records = reinterpret_cast<const SnapshotRecord*>(base + sizeof(SnapshotHeader));
+  const uint8_t* payload = base + sizeof(SnapshotHeader) + recordsSize;
+  values.reserve(header->recordCount);
+
+  for (uint32_t i = 0; i < header->recordCount; i++) {
+    const SnapshotRecord& record = records[i];
+    const size_t recordSize = record.int64Count * sizeof(int64_t) + record.int32Count * sizeof(int32_t) +
+                              record.floatCount * sizeof(float) + record.byteCount + record.stringSize;
+    if (record.payloadOffset + recordSize > header->payloadSize) {
+      ALOGW("PropertySnapshot - record for prop 0x%x is out of bounds", record.prop);
+      continue;
+    }
+
+    const uint8_t* cursor = payload + record.payloadOffset;
+    VehiclePropValue value = {
+        .timestamp = record.timestamp,
+        .areaId = record.areaId,
+        .prop = record.prop,
+        .status = static_cast<VehiclePropertyStatus>(record.status),
+    };
+    value.value.int64Values = readArray<int64_t>(cursor, record.int64Count);
+    value.value.int32Values = readArray<int32_t>(cursor, record.int32Count);
+    value.value.floatValues = readArray<float>(cursor, record.floatCount);
+    value.value.byteValues = readArray<uint8_t>(cursor, record.byteCount);
+    value.value.stringValue.assign(reinterpret_cast<const char*>(cursor), record.stringSize);
+    values.push_back(std::move(value));
+  }
+
+  munmap(mapping, size);
+  ALOGI("PropertySnapshot - loaded %zu values from %s", values.size(), mPath.c_str());
+  return values;
+}
+
+}  // namespace vendor::spyrosoft::vehicle
@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2023 Spyrosoft Synergy S.A.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <VehicleHalTypes.h>
+#include <VehiclePropertyStore.h>
+
+#include <string>
+#include <vector>
+
+namespace vendor::spyrosoft::vehicle {
+
+/**
+ * @brief Warm-restart snapshot of the property store.
+ *
+ * The file is a fixed header followed by an array of fixed-size records and a payload area with
+ * the value vectors, so it can be mapped and read in place. A snapshot is written to a temporary
+ * file, synced and renamed over the previous one, so a crash leaves either the old or the new
+ * snapshot on disk, never a partial one.
+ */
+class PropertySnapshot {
+ public:
+  explicit PropertySnapshot(std::string path);
+
+  // Whether the directory of the snapshot exists and is writable. /data is mounted after early HALs
+  // start on a cold boot.
+  bool isStorageReady() const;
+
+  bool save(const std::vector<android::hardware::automotive::vehicle::VehiclePropValuePool::RecyclableType>& values);
+
+  std::vector<aidl::android::hardware::automotive::vehicle::VehiclePropValue> load() const;
+
+ private:
+  const std::string mPath;
+};
+
+}  // namespace vendor::spyrosoft::vehicle
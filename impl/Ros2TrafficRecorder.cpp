@@ -0,0 +1,204 @@
+/*
+ * Copyright (c) 2023 Spyrosoft Synergy S.A.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "Ros2TrafficRecorder.h"
+
+#include <android-base/file.h>
+#include <fcntl.h>
+#include <utils/SystemClock.h>
+
+#include <cstring>
+
+#include "common/logging.hpp"
+
+namespace vendor::spyrosoft::vehicle {
+
+using aidl::android::hardware::automotive::vehicle::VehiclePropertyStatus;
+using aidl::android::hardware::automotive::vehicle::VehiclePropValue;
+
+namespace {
+
+constexpr uint32_t kLogMagic = 0x56545232;  // "VTR2"
+constexpr uint32_t kLogVersion = 1;
+constexpr size_t kFlushThreshold = 64 * 1024;
+
+struct LogHeader {
+  uint32_t magic;
+  uint32_t version;
+};
+
+struct RecordHeader {
+  uint8_t type;
+  uint8_t reserved[3];
+  uint32_t valueCounts[5];  // int64, int32, float, byte, string
+  int32_t prop;
+  int32_t areaId;
+  int32_t status;
+  int32_t reserved2;
+  int64_t timestamp;
+  int64_t requestId;
+  int64_t valueTimestamp;
+};
+
+static_assert(sizeof(RecordHeader) == 64);
+
+template <class T>
+void append(std::vector<uint8_t>& buffer, const T* data, size_t count)
+{
+  const auto* bytes = reinterpret_cast<const uint8_t*>(data);
+  buffer.insert(buffer.end(), bytes, bytes + count * sizeof(T));
+}
+
+template <class T>
+void readArray(const uint8_t*& cursor, uint32_t count, std::vector<T>& out)
+{
+  out.resize(count);
+  std::memcpy(out.data(), cursor, count * sizeof(T));
+  cursor += count * sizeof(T);
+}
+
+}  // namespace
+
+TrafficRecorder::TrafficRecorder(const std::string& path)
+    : mFd(TEMP_FAILURE_RETRY(open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600)))
+{
+  if (mFd == -1) {
+    ALOGE("TrafficRecorder - failed to open %s: %s", path.c_str(), strerror(errno));
+    return;
+  }
+
+  const LogHeader header = {.magic = kLogMagic, .version = kLogVersion};
+  mBuffer.reserve(kFlushThreshold * 2);
+  append(mBuffer, &header, 1);
+  ALOGI("TrafficRecorder - capturing to %s", path.c_str());
+}
+
+TrafficRecorder::~TrafficRecorder() { flush(); }
+
+void TrafficRecorder::record(TrafficRecordType type, int64_t requestId, const VehiclePropValue& value)
+{
+  if (mFd == -1) {
+    return;
+  }
+
+  const auto& raw = value.value;
+  const RecordHeader header = {
+      .type = static_cast<uint8_t>(type),
+      .reserved = {},
+      .valueCounts = {static_cast<uint32_t>(raw.int64Values.size()), static_cast<uint32_t>(raw.int32Values.size()),
+                      static_cast<uint32_t>(raw.floatValues.size()), static_cast<uint32_t>(raw.byteValues.size()),
+                      static_cast<uint32_t>(raw.stringValue.size())},
+      .prop = value.prop,
+      .areaId = value.areaId,
+      .status = static_cast<int32_t>(value.status),
+      .reserved2 = 0,
+      .timestamp = android::elapsedRealtimeNano(),
+      .requestId = requestId,
+      .valueTimestamp = value.timestamp,
+  };
+
+  std::lock_guard<std::mutex> lock(mLock);
+  append(mBuffer, &header, 1);
+  append(mBuffer, raw.int64Values.data(), raw.int64Values.size());
+  append(mBuffer, raw.int32Values.data(), raw.int32Values.size());
+  append(mBuffer, raw.floatValues.data(), raw.floatValues.size());
+  append(mBuffer, raw.byteValues.data(), raw.byteValues.size());
+  append(mBuffer, raw.stringValue.data(), raw.stringValue.size());
+
+  if (mBuffer.size() >= kFlushThreshold) {
+    flushLocked();
+  }
+}
+
+void TrafficRecorder::flush()
+{
+  std::lock_guard<std::mutex> lock(mLock);
+  flushLocked();
+}
+
+void TrafficRecorder::flushLocked()
+{
+  if (mFd == -1 || mBuffer.empty()) {
+    return;
+  }
+
+  if (!android::base::WriteFully(mFd, mBuffer.data(), mBuffer.size())) {
+    ALOGE("TrafficRecorder - write failed, capture stopped: %s", strerror(errno));
+    mFd.reset();
+  }
+  mBuffer.clear();
+}
+
+TrafficLogReader::TrafficLogReader(const std::string& path)
+{
+  std::string content;
+  if (!android::base::ReadFileToString(path, &content) || content.size() < sizeof(LogHeader)) {
+    ALOGE("TrafficLogReader - failed to read %s", path.c_str());
+    return;
+  }
+
+  LogHeader header;
+  std::memcpy(&header, content.data(), sizeof(header));
+  if (header.magic != kLogMagic || header.version != kLogVersion) {
+    ALOGE("TrafficLogReader - %s is not a traffic log", path.c_str());
+    return;
+  }
+
+  mData.assign(content.begin(), content.end());
+  mOffset = sizeof(LogHeader);
+  mValid = true;
+}
+
+bool TrafficLogReader::next(TrafficRecord& record)
+{
+  if (!mValid || mOffset + sizeof(RecordHeader) > mData.size()) {
+    return false;
+  }
+
+  RecordHeader header;
+  std::memcpy(&header, mData.data() + mOffset, sizeof(header));
+  const size_t payloadSize = header.valueCounts[0] * sizeof(int64_t) + header.valueCounts[1] * sizeof(int32_t) +
+                             header.valueCounts[2] * sizeof(float) + header.valueCounts[3] + header.valueCounts[4];
+  if (mOffset + sizeof(RecordHeader) + payloadSize > mData.size()) {
+    // Truncated tail of a log that was cut short.
+    return false;
+  }
+
+  const uint8_t* cursor = mData.data() + mOffset + sizeof(RecordHeader);
+  record.type = static_cast<TrafficRecordType>(header.type);
+  record.timestamp = header.timestamp;
+  record.requestId = header.requestId;
+  record.value.timestamp = header.valueTimestamp;
+  record.value.areaId = header.areaId;
+  record.value.prop = header.prop;
+  record.value.status = static_cast<VehiclePropertyStatus>(header.status);
+  readArray(cursor, header.valueCounts[0], record.value.value.int64Values);
+  readArray(cursor, header.valueCounts[1], record.value.value.int32Values);
+  readArray(cursor, header.valueCounts[2], record.value.value.floatValues);
+  readArray(cursor, header.valueCounts[3], record.value.value.byteValues);
+  record.value.value.stringValue.assign(reinterpret_cast<const char*>(cursor), header.valueCounts[4]);
+
+  mOffset += sizeof(RecordHeader) + payloadSize;
+  return true;
+}
+
+}  // namespace vendor::spyrosoft::vehicle
@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2023 Spyrosoft Synergy S.A.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <VehicleHalTypes.h>
+#include <android-base/unique_fd.h>
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace vendor::spyrosoft::vehicle {
+
+enum class TrafficRecordType : uint8_t {
+  GET_REQUEST = 1,
+  SET_REQUEST = 2,
+  OUTBOUND_SET = 3,
+  INBOUND_SAMPLE = 4,
+};
+
+struct TrafficRecord {
+  TrafficRecordType type;
+  // elapsedRealtimeNano() at capture time.
+  int64_t timestamp;
+  // GetValueRequest/SetValueRequest id, 0 for bridge traffic.
+  int64_t requestId;
+  aidl::android::hardware::automotive::vehicle::VehiclePropValue value;
+};
+
+/**
+ * @brief Captures VHAL requests and ROS traffic to a compact binary log.
+ *
+ * Records are appended to an in-memory buffer and written out in blocks, so capturing does not
+ * add a syscall to every request. Owners call flush() periodically, so a capture of a process that
+ * is killed loses at most the records since the last flush.
+ */
+class TrafficRecorder {
+ public:
+  explicit TrafficRecorder(const std::string& path);
+  ~TrafficRecorder();
+
+  bool isOpen() const { return mFd != -1; }
+
+  void record(TrafficRecordType type, int64_t requestId,
+              const aidl::android::hardware::automotive::vehicle::VehiclePropValue& value);
+
+  void flush();
+
+ private:
+  android::base::unique_fd mFd;
+  std::mutex mLock;
+  std::vector<uint8_t> mBuffer;
+
+  void flushLocked();
+};
+
+/**
+ * @brief Sequential reader of a log written by TrafficRecorder.
+ *
+ */
+class TrafficLogReader {
+ public:
+  explicit TrafficLogReader(const std::string& path);
+
+  bool isOpen() const { return mValid; }
+
+  bool next(TrafficRecord& record);
+
+ private:
+  std::vector<uint8_t> mData;
+  size_t mOffset = 0;
+  bool mValid = false;
+};
+
+}  // namespace vendor::spyrosoft::vehicle
@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2023 Spyrosoft Synergy S.A.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <ros2_android_vhal/msg/vehicle_property.h>
+#include <ros2_android_vhal/srv/get_vehicle_property.h>
+#include <ros2_android_vhal/srv/set_vehicle_property.h>
+
+#include <chrono>
+#include <functional>
+#include <optional>
+
+namespace vendor::spyrosoft::vehicle::ros2 {
+
+/**
+ * @brief Session with a micro-ROS agent, as driven by ROS2Bridge.
+ *
+ * ROS2Bridge owns the connection state machine and the message encoding, a Transport only moves
+ * messages. All calls except wakeup() are made from the session's bridge thread.
+ */
+class Transport {
+ public:
+  // SetVehicleProperty_Response.result and GetVehicleProperty_Response.result of a served request.
+  static constexpr int32_t kResultOk = 0;
+
+  using SampleCallback = std::function<void(const ros2_android_vhal__msg__VehicleProperty&)>;
+  using SetResponseCallback = std::function<void(const ros2_android_vhal__srv__SetVehicleProperty_Response&)>;
+  using GetResponseCallback = std::function<void(const ros2_android_vhal__srv__GetVehicleProperty_Response&)>;
+
+  virtual ~Transport() = default;
+
+  // Locates an agent, returns false when none answered.
+  virtual bool discoverAgent() = 0;
+  virtual bool pingAgent() = 0;
+
+  // Creates and destroys the node, clients and subscriptions of the session.
+  virtual void createEntities() = 0;
+  virtual void destroyEntities() = 0;
+
+  virtual bool sendSetRequest(const ros2_android_vhal__srv__SetVehicleProperty_Request& request) = 0;
+  virtual bool sendGetRequest(const ros2_android_vhal__srv__GetVehicleProperty_Request& request) = 0;
+
+  // Waits for incoming data for at most timeout and dispatches it, the callbacks are invoked from
+  // here. Returns as soon as something was processed or wakeup() was called.
+  virtual void spin(std::chrono::nanoseconds timeout) = 0;
+
+  // Makes a spin() in progress return early, may be called from any thread. Transports that can't
+  // interrupt a wait in progress notice it within a bounded delay instead.
+  virtual void wakeup() = 0;
+
+  // Synchronizes with the agent clock and returns the agent epoch time in ns, taken at the moment
+  // of return. Transports without a clock of their own return std::nullopt.
+  virtual std::optional<int64_t> syncClock() { return std::nullopt; }
+
+  void setCallbacks(SampleCallback onSample, SetResponseCallback onSetResponse, GetResponseCallback onGetResponse)
+  {
+    m_onSample = std::move(onSample);
+    m_onSetResponse = std::move(onSetResponse);
+    m_onGetResponse = std::move(onGetResponse);
+  }
+
+ protected:
+  SampleCallback m_onSample;
+  SetResponseCallback m_onSetResponse;
+  GetResponseCallback m_onGetResponse;
+};
+
+}  // namespace vendor::spyrosoft::vehicle::ros2
@@ -20,8 +20,13 @@
  */
 #include "Ros2VehicleHardware.h"
 
+#include <android-base/stringprintf.h>
 #include <utils/SystemClock.h>
 
+#include <algorithm>
+
+#include "Ros2PoolAllocator.h"
+
 using namespace std::chrono_literals;
 
 namespace vendor::spyrosoft::vehicle {
@@ -33,48 +38,89 @@ using aidl::android::hardware::automotive::vehicle::SetValueRequest;
 using aidl::android::hardware::automotive::vehicle::SetValueResult;
 using aidl::android::hardware::automotive::vehicle::StatusCode;
 using aidl::android::hardware::automotive::vehicle::VehiclePropConfig;
+using aidl::android::hardware::automotive::vehicle::VehiclePropertyChangeMode;
 using aidl::android::hardware::automotive::vehicle::VehiclePropValue;
+using android::base::StringPrintf;
 using android::hardware::automotive::vehicle::DumpResult;
+using android::hardware::automotive::vehicle::PropIdAreaId;
 using android::hardware::automotive::vehicle::VehiclePropertyStore;
 using android::hardware::automotive::vehicle::VehiclePropValuePool;
 using android::hardware::automotive::vehicle::defaultconfig::ConfigDeclaration;
 
-void Ros2VehicleHardware::storePropInitialValue(const ConfigDeclaration& config)
-{
-  const VehiclePropConfig& vehiclePropConfig = config.config;
-  int propId = vehiclePropConfig.prop;
+namespace {
 
-  // A global property will have only a single area
-  bool globalProp = android::hardware::automotive::vehicle::isGlobalProp(propId);
-  size_t numAreas = globalProp ? 1 : vehiclePropConfig.areaConfigs.size();
+// How often the worker and bridge heartbeats are checked against the stall timeout and the SLO.
+constexpr auto kHealthCheckInterval = 1s;
 
-  for (size_t i = 0; i < numAreas; i++) {
-    int32_t curArea = globalProp ? 0 : vehiclePropConfig.areaConfigs[i].areaId;
+// The service is killed rather than shut down, so a capture is written out at least this often.
+constexpr auto kRecordFlushInterval = 1s;
 
-    // Create a separate instance for each individual zone
-    VehiclePropValue prop = {
-        .areaId = curArea,
-        .prop = propId,
-        .timestamp = android::elapsedRealtimeNano(),
-    };
+// How often the snapshot directory is looked for when it didn't exist at startup.
+constexpr auto kSnapshotLoadRetryInterval = 1s;
 
-    if (config.initialAreaValues.empty()) {
-      if (config.initialValue == RawPropValues{}) {
-        // Skip empty initial values.
+// Flattens the default config declarations into a table of initial area values.
+std::vector<VehiclePropValue> build_initial_value_table()
+{
+  const auto& configs = android::hardware::automotive::vehicle::defaultconfig::getDefaultConfigs();
+  std::vector<VehiclePropValue> values;
+  values.reserve(configs.size());
+
+  for (const ConfigDeclaration& config : configs) {
+    const VehiclePropConfig& vehiclePropConfig = config.config;
+    int propId = vehiclePropConfig.prop;
+
+    // A global property will have only a single area
+    bool globalProp = android::hardware::automotive::vehicle::isGlobalProp(propId);
+    size_t numAreas = globalProp ? 1 : vehiclePropConfig.areaConfigs.size();
+
+    for (size_t i = 0; i < numAreas; i++) {
+      int32_t curArea = globalProp ? 0 : vehiclePropConfig.areaConfigs[i].areaId;
+
+      // Create a separate instance for each individual zone
+      VehiclePropValue prop = {
+          .areaId = curArea,
+          .prop = propId,
+      };
+
+      if (config.initialAreaValues.empty()) {
+        if (config.initialValue == RawPropValues{}) {
+          // Skip empty initial values.
+          continue;
+        }
+        prop.value = config.initialValue;
+      }
+      else if (auto valueForAreaIt = config.initialAreaValues.find(curArea);
+               valueForAreaIt != config.initialAreaValues.end()) {
+        prop.value = valueForAreaIt->second;
+      }
+      else {
+        ALOGW("failed to get default value for prop 0x%x area 0x%x", propId, curArea);
         continue;
       }
-      prop.value = config.initialValue;
-    }
-    else if (auto valueForAreaIt = config.initialAreaValues.find(curArea);
-             valueForAreaIt != config.initialAreaValues.end()) {
-      prop.value = valueForAreaIt->second;
-    }
-    else {
-      ALOGW("failed to get default value for prop 0x%x area 0x%x", propId, curArea);
-      continue;
+
+      values.push_back(std::move(prop));
     }
+  }
+  return values;
+}
+
+// The table only depends on the compiled-in default configs. It is built once on first use, after
+// logging is up rather than during static initialization, and later store populations copy it.
+const std::vector<VehiclePropValue>& initial_value_table()
+{
+  static const std::vector<VehiclePropValue> table = build_initial_value_table();
+  return table;
+}
+
+}  // namespace
 
-    auto result = mServerSidePropStore->writeValue(mValuePool->obtain(prop), /*updateStatus=*/true);
+void Ros2VehicleHardware::storeInitialValues(const std::vector<VehiclePropValue>& values, int64_t timestamp)
+{
+  for (const auto& value : values) {
+    auto prop = mValuePool->obtain(value);
+    prop->timestamp = timestamp;
+
+    auto result = mServerSidePropStore->writeValue(std::move(prop), /*updateStatus=*/true);
     if (!result.ok()) {
       ALOGE("failed to write default config value, error: %s, status: %d", getErrorMsg(result).c_str(),
             getIntErrorCode(result));
@@ -82,21 +128,50 @@ void Ros2VehicleHardware::storePropInitialValue(const ConfigDeclaration& config)
   }
 }
 
-Ros2VehicleHardware::Ros2VehicleHardware(std::unique_ptr<ros2::ROS2Bridge> ros_bridge)
-    : mRos2Bridge(std::move(ros_bridge)),
+Ros2VehicleHardware::Ros2VehicleHardware(std::unique_ptr<ros2::ROS2Bridge> ros_bridge, Config config)
+    : mConfig(std::move(config)),
+      mRos2Bridge(std::move(ros_bridge)),
       mValuePool(std::move(std::make_unique<VehiclePropValuePool>())),
       mServerSidePropStore(std::make_unique<VehiclePropertyStore>(mValuePool)),
+      mRecurrentTimer(std::make_unique<android::hardware::automotive::vehicle::RecurrentTimer>()),
       mPendingGetValueRequests(this),
       mPendingSetValueRequests(this)
 {
-  mRos2Bridge->start(45s);
-  for (auto& it : android::hardware::automotive::vehicle::defaultconfig::getDefaultConfigs()) {
+  if (!mConfig.recordPath.empty()) {
+    mRecorder = std::make_unique<TrafficRecorder>(mConfig.recordPath);
+    mRecordFlushCallback = std::make_shared<android::hardware::automotive::vehicle::RecurrentTimer::Callback>(
+        [this]() { mRecorder->flush(); });
+    mRecurrentTimer->registerTimerCallback(std::chrono::nanoseconds(kRecordFlushInterval).count(),
+                                          mRecordFlushCallback);
+  }
+
+  // Initial values are stamped before the bridge starts, so any vehicle sample supersedes them.
+  const int64_t initialTimestamp = android::elapsedRealtimeNano();
+  for (const auto& it : android::hardware::automotive::vehicle::defaultconfig::getDefaultConfigs()) {
     mServerSidePropStore->registerProperty(it.config, nullptr);
-    storePropInitialValue(it);
+    if (it.config.changeMode == VehiclePropertyChangeMode::CONTINUOUS) {
+      mContinuousProps.insert(it.config.prop);
+    }
+  }
+  storeInitialValues(initial_value_table(), initialTimestamp);
+
+  // Last-known values from the previous run take precedence over the defaults.
+  if (!mConfig.snapshotPath.empty()) {
+    mSnapshot = std::make_unique<PropertySnapshot>(mConfig.snapshotPath);
+    mSnapshotTimestamp = initialTimestamp;
+    loadSnapshot();
   }
 
   mServerSidePropStore->setOnValueChangeCallback([this](const VehiclePropValue& value) {
+    if (mContinuousProps.count(value.prop) == 0) {
+      mStoreGeneration++;
+    }
     std::scoped_lock<std::mutex> lockGuard(mLock);
+    if (mBatchWriter == std::this_thread::get_id()) {
+      // Part of a zoned batch, reported with the rest of it.
+      mBatchChanges.push_back(value);
+      return;
+    }
     if (!mOnPropertyChangeCallback) {
       return;
     }
@@ -107,9 +182,98 @@ Ros2VehicleHardware::Ros2VehicleHardware(std::unique_ptr<ros2::ROS2Bridge> ros_b
     }
   });
 
+  // Requests are answered from here on, the bridge comes up on its own threads.
+  mReady = true;
+
+  // Only once the store is populated, so inbound samples find their property registered.
+  mRos2Bridge->setOnPropertyUpdate([this](VehiclePropValue value) { handlePropertyUpdate(std::move(value)); });
+  mRos2Bridge->setOnPropertyBatch(
+      [this](std::vector<VehiclePropValue> values) { handlePropertyBatch(std::move(values)); });
+  mRos2Bridge->setOnGetResponse([this](int32_t propId, int32_t areaId, std::optional<VehiclePropValue> value) {
+    completeFetch(PropIdAreaId{.propId = propId, .areaId = areaId}, std::move(value));
+  });
+  mRos2Bridge->start();
+
+  if (mSnapshot && !mSnapshotLoaded) {
+    // Stamped like the defaults, so whatever the vehicle or a client wrote in the meantime wins.
+    mSnapshotLoadCallback = std::make_shared<android::hardware::automotive::vehicle::RecurrentTimer::Callback>(
+        [this]() {
+          loadSnapshot();
+          if (mSnapshotLoaded) {
+            mRecurrentTimer->unregisterTimerCallback(mSnapshotLoadCallback);
+          }
+        });
+    mRecurrentTimer->registerTimerCallback(std::chrono::nanoseconds(kSnapshotLoadRetryInterval).count(),
+                                          mSnapshotLoadCallback);
+  }
+  if (mSnapshot && mConfig.snapshotInterval.count() > 0) {
+    mSnapshotCallback = std::make_shared<android::hardware::automotive::vehicle::RecurrentTimer::Callback>(
+        [this]() { saveSnapshot(); });
+    mRecurrentTimer->registerTimerCallback(std::chrono::nanoseconds(mConfig.snapshotInterval).count(),
+                                          mSnapshotCallback);
+  }
+
+  if (!mConfig.readThroughTtl.empty()) {
+    mFetchExpiryCallback = std::make_shared<android::hardware::automotive::vehicle::RecurrentTimer::Callback>(
+        [this]() { expireFetches(); });
+    mRecurrentTimer->registerTimerCallback(std::chrono::nanoseconds(mConfig.readThroughTimeout).count() / 2,
+                                          mFetchExpiryCallback);
+  }
+
+  mHealthCallback = std::make_shared<android::hardware::automotive::vehicle::RecurrentTimer::Callback>(
+      [this]() { evaluateHealth(); });
+  mRecurrentTimer->registerTimerCallback(std::chrono::nanoseconds(kHealthCheckInterval).count(), mHealthCallback);
+
   ALOGI("Ros2VehicleHardware created");
 }
 
+Ros2VehicleHardware::~Ros2VehicleHardware()
+{
+  // Unregistering doesn't wait for a callback in progress, destroying the timer joins its thread.
+  mRecurrentTimer.reset();
+  // Joins the session threads, no vehicle sample or get answer arrives past this point.
+  mRos2Bridge->stop();
+  mPendingGetValueRequests.stop();
+  mPendingSetValueRequests.stop();
+  saveSnapshot();
+}
+
+void Ros2VehicleHardware::loadSnapshot()
+{
+  if (mSnapshotLoaded || !mSnapshot->isStorageReady()) {
+    return;
+  }
+  {
+    // Kept out of a zoned batch like the set writes, values written since startup are newer and win.
+    std::shared_lock<std::shared_mutex> transaction(mStoreTransactionLock);
+    storeInitialValues(mSnapshot->load(), mSnapshotTimestamp);
+  }
+  mSnapshotLoaded = true;
+  ALOGI("Loaded property snapshot %s", mConfig.snapshotPath.c_str());
+}
+
+void Ros2VehicleHardware::saveSnapshot()
+{
+  // Saving before the previous snapshot was loaded would replace it with the defaults.
+  if (!mSnapshot || !mSnapshotLoaded) {
+    return;
+  }
+
+  const uint64_t generation = mStoreGeneration;
+  if (generation == mSnapshotGeneration) {
+    return;
+  }
+
+  // Continuous signals are stale by the time the service restarts, the vehicle resends them anyway.
+  auto values = mServerSidePropStore->readAllValues();
+  values.erase(std::remove_if(values.begin(), values.end(),
+                              [this](const auto& value) { return mContinuousProps.count(value->prop) != 0; }),
+               values.end());
+  if (mSnapshot->save(values)) {
+    mSnapshotGeneration = generation;
+  }
+}
+
 std::vector<VehiclePropConfig> Ros2VehicleHardware::getAllPropertyConfigs() const
 {
   ALOGI("Ros2VehicleHardware::getAllPropertyConfigs");
@@ -119,7 +283,17 @@ std::vector<VehiclePropConfig> Ros2VehicleHardware::getAllPropertyConfigs() cons
 StatusCode Ros2VehicleHardware::setValues(std::shared_ptr<const SetValuesCallback> callback,
                                           const std::vector<SetValueRequest>& requests)
 {
+  std::vector<SetValueResult> shed;
   for (auto& request : requests) {
+    if (mRecorder) {
+      mRecorder->record(TrafficRecordType::SET_REQUEST, request.requestId, request.value);
+    }
+    if (shouldShed(request.value.prop)) {
+      // Answered right away so low-priority writes don't queue behind the backlog.
+      mShedSets++;
+      shed.push_back({.requestId = request.requestId, .status = StatusCode::TRY_AGAIN});
+      continue;
+    }
     // In a real VHAL implementation, you could either send the setValue request to vehicle bus
     // here in the binder thread, or you could send the request in setValue which runs in
     // the handler thread. If you decide to send the setValue request here, you should not
@@ -127,6 +301,9 @@ StatusCode Ros2VehicleHardware::setValues(std::shared_ptr<const SetValuesCallbac
     mPendingSetValueRequests.addRequest(request, callback);
   }
 
+  if (!shed.empty()) {
+    (*callback)(std::move(shed));
+  }
   return StatusCode::OK;
 }
 
@@ -134,6 +311,9 @@ StatusCode Ros2VehicleHardware::getValues(std::shared_ptr<const GetValuesCallbac
                                           const std::vector<GetValueRequest>& requests) const
 {
   for (auto& request : requests) {
+    if (mRecorder) {
+      mRecorder->record(TrafficRecordType::GET_REQUEST, request.requestId, request.prop);
+    }
     // In a real VHAL implementation, you could either send the getValue request to vehicle bus
     // here in the binder thread, or you could send the request in getValue which runs in
     // the handler thread. If you decide to send the getValue request here, you should not
@@ -146,11 +326,131 @@ StatusCode Ros2VehicleHardware::getValues(std::shared_ptr<const GetValuesCallbac
 
 DumpResult Ros2VehicleHardware::dump(const std::vector<std::string>& /*options*/)
 {
-  ALOGW("Ros2VehicleHardware::dump() - not implemented");
-  return DumpResult{true, std::string{""}};
+  const ros2::BridgeStats stats = mRos2Bridge->stats();
+
+  std::string buffer = StringPrintf("ROS 2 bridge: %s\n", mRos2Bridge->is_connected() ? "connected" : "disconnected");
+  buffer += StringPrintf("  inbound latency: %s\n", stats.inboundLatency.toString().c_str());
+  buffer += StringPrintf("  outbound queueing: %s\n", stats.outboundQueueing.toString().c_str());
+  buffer += StringPrintf("  set round trip: %s\n", stats.setRoundTrip.toString().c_str());
+  buffer += StringPrintf("  fragments: %llu sent, %llu transfers received, %llu dropped\n",
+                         static_cast<unsigned long long>(stats.fragmentsSent),
+                         static_cast<unsigned long long>(stats.transfersReceived),
+                         static_cast<unsigned long long>(stats.transfersDropped));
+  buffer += StringPrintf("  zoned batches: %llu sent, %llu received\n",
+                         static_cast<unsigned long long>(stats.zonedBatchesSent),
+                         static_cast<unsigned long long>(stats.zonedBatchesReceived));
+  for (size_t i = 0; i < stats.clocks.size(); i++) {
+    const auto& clock = stats.clocks[i];
+    buffer += StringPrintf("  session %zu clock: %s, offset %lld ns, drift %.3f ppm, %llu syncs\n", i,
+                           clock.synced ? "synced" : "not synced", static_cast<long long>(clock.offsetNs),
+                           clock.driftPpm, static_cast<unsigned long long>(clock.syncs));
+  }
+
+  const int64_t now = android::elapsedRealtimeNano();
+  buffer += StringPrintf("Health: %s%s\n", isHealthy() ? "healthy" : "stalled", mDegraded ? ", degraded" : "");
+  for (size_t i = 0; i < stats.sessions.size(); i++) {
+    const auto& session = stats.sessions[i];
+    buffer += StringPrintf("  session %zu loop: %llu heartbeats, last %lld ms ago\n", i,
+                           static_cast<unsigned long long>(session.heartbeats),
+                           static_cast<long long>((now - session.lastHeartbeatNs) / 1000000));
+  }
+  const auto dumpWorker = [&buffer, now](const char* name, const auto& progress) {
+    buffer += StringPrintf("  %s worker: %llu heartbeats, %llu pending, last %lld ms ago, queue latency %lld us\n",
+                           name, static_cast<unsigned long long>(progress.heartbeats),
+                           static_cast<unsigned long long>(progress.pending),
+                           static_cast<long long>((now - progress.lastProgressNs) / 1000000),
+                           static_cast<long long>(progress.lastQueueLatencyNs / 1000));
+  };
+  dumpWorker("get", mPendingGetValueRequests.progress());
+  dumpWorker("set", mPendingSetValueRequests.progress());
+  buffer += StringPrintf("  shed: %llu sets, %llu reads\n", static_cast<unsigned long long>(mShedSets),
+                         static_cast<unsigned long long>(mShedReads));
+
+  if (const auto* pool = ros2::PoolAllocator::installed()) {
+    buffer += pool->dump();
+  }
+
+  // The default VHAL appends the property store dump when callerShouldDumpState is set.
+  return DumpResult{.callerShouldDumpState = true, .buffer = buffer};
+}
+
+StatusCode Ros2VehicleHardware::checkHealth()
+{
+  if (!mReady) {
+    return StatusCode::TRY_AGAIN;
+  }
+  return isHealthy() ? StatusCode::OK : StatusCode::INTERNAL_ERROR;
+}
+
+bool Ros2VehicleHardware::isHealthy()
+{
+  // Evaluated on demand as well, so a stalled timer thread can't keep reporting stale health.
+  evaluateHealth();
+  return mHealthy;
+}
+
+void Ros2VehicleHardware::evaluateHealth()
+{
+  std::scoped_lock<std::mutex> lockGuard(mHealthLock);
+
+  const int64_t now = android::elapsedRealtimeNano();
+  const int64_t stallTimeout = std::chrono::nanoseconds(mConfig.stallTimeout).count();
+  const int64_t slo = std::chrono::nanoseconds(mConfig.queueLatencySlo).count();
+
+  bool stalled = false;
+  const auto checkWorker = [&](const char* name, const auto& progress) {
+    const int64_t busyFor = progress.busySinceNs != 0 ? now - progress.busySinceNs : 0;
+    if (busyFor > stallTimeout) {
+      ALOGW("health: %s worker stuck for %lld ms", name, static_cast<long long>(busyFor / 1000000));
+      stalled = true;
+    }
+    // A batch still being handled counts against the SLO before it reports its own latency.
+    if (progress.pending != 0 && busyFor > slo) {
+      mLastSloBreachNs = now;
+    }
+    else if (progress.lastQueueLatencyNs > slo) {
+      mLastSloBreachNs = std::max(mLastSloBreachNs, progress.lastProgressNs);
+    }
+  };
+  checkWorker("get", mPendingGetValueRequests.progress());
+  checkWorker("set", mPendingSetValueRequests.progress());
+
+  const auto sessions = mRos2Bridge->stats().sessions;
+  for (size_t i = 0; i < sessions.size(); i++) {
+    if (now - sessions[i].lastHeartbeatNs > stallTimeout) {
+      ALOGW("health: session %zu loop stuck for %lld ms", i,
+            static_cast<long long>((now - sessions[i].lastHeartbeatNs) / 1000000));
+      stalled = true;
+    }
+  }
+
+  if (mHealthy.exchange(!stalled) == stalled) {
+    ALOGW("health: %s", stalled ? "stalled" : "recovered");
+  }
+  const bool overSlo = mLastSloBreachNs != 0 &&
+                       now - mLastSloBreachNs < std::chrono::nanoseconds(mConfig.degradedRecovery).count();
+  if (mDegraded.exchange(overSlo) != overSlo) {
+    if (overSlo) {
+      ALOGW("health: queue latency SLO of %lld ms breached%s", static_cast<long long>(mConfig.queueLatencySlo.count()),
+            mConfig.degradedMode ? ", shedding low-priority requests" : "");
+    }
+    else {
+      ALOGW("health: queue latency SLO of %lld ms met for %lld ms",
+            static_cast<long long>(mConfig.queueLatencySlo.count()),
+            static_cast<long long>(mConfig.degradedRecovery.count()));
+    }
+  }
 }
 
-StatusCode Ros2VehicleHardware::checkHealth() { return StatusCode::OK; }
+bool Ros2VehicleHardware::shouldShed(int32_t propId) const
+{
+  if (!mConfig.degradedMode || !mDegraded) {
+    return false;
+  }
+  const PropertyDomain domain = getPropertyDomain(propId);
+  return std::find(mConfig.lowPriorityDomains.begin(), mConfig.lowPriorityDomains.end(), domain) !=
+         mConfig.lowPriorityDomains.end();
+}
 
 void Ros2VehicleHardware::registerOnPropertyChangeEvent(std::unique_ptr<const PropertyChangeCallback> callback)
 {
@@ -177,6 +477,8 @@ GetValueResult Ros2VehicleHardware::handleGetValueRequest(const GetValueRequest&
   GetValueResult getValueResult;
   getValueResult.requestId = request.requestId;
 
+  // Never observe half of a zoned batch.
+  std::shared_lock<std::shared_mutex> transaction(mStoreTransactionLock);
   auto readResult = mServerSidePropStore->readValue(request.prop);
   if (!readResult.ok()) {
     getValueResult.status = StatusCode::INTERNAL_ERROR;
@@ -188,36 +490,29 @@ GetValueResult Ros2VehicleHardware::handleGetValueRequest(const GetValueRequest&
   return getValueResult;
 }
 
-SetValueResult Ros2VehicleHardware::handleSetValueRequest(const SetValueRequest& request)
+SetValueResult Ros2VehicleHardware::handleSetValueRequest(SetValueRequest request,
+                                                          std::vector<VehiclePropValue>& outbound)
 {
   SetValueResult setValueResult;
   setValueResult.requestId = request.requestId;
 
+  // The store keeps a pooled copy, the request's own value is moved on to the vehicle.
+  request.value.timestamp = android::elapsedRealtimeNano();
   auto updatedValue = mValuePool->obtain(request.value);
-  updatedValue->timestamp = android::elapsedRealtimeNano();
 
   const auto property = aidl::android::hardware::automotive::vehicle::VehicleProperty(updatedValue->prop);
   ALOGI("Ros2VehicleHardware::handleSetValueRequest: %s",
         aidl::android::hardware::automotive::vehicle::toString(property).c_str());
 
   if (mRos2Bridge->is_connected()) {
-    if (!updatedValue->value.int64Values.empty())
-      (void)mRos2Bridge->setProperty(updatedValue->timestamp, updatedValue->areaId, updatedValue->prop,
-                                     updatedValue->value.int64Values[0]);
-    else if (!updatedValue->value.floatValues.empty())
-      (void)mRos2Bridge->setProperty(updatedValue->timestamp, updatedValue->areaId, updatedValue->prop,
-                                     updatedValue->value.floatValues[0]);
-    else if (!updatedValue->value.int32Values.empty())
-      (void)mRos2Bridge->setProperty(updatedValue->timestamp, updatedValue->areaId, updatedValue->prop,
-                                     updatedValue->value.int32Values[0]);
-    else if (!updatedValue->value.byteValues.empty())
-      (void)mRos2Bridge->setProperty(updatedValue->timestamp, updatedValue->areaId, updatedValue->prop,
-                                     updatedValue->value.byteValues[0]);
-    else if (!updatedValue->value.stringValue.empty())
-      (void)mRos2Bridge->setProperty(updatedValue->timestamp, updatedValue->areaId, updatedValue->prop,
-                                     updatedValue->value.stringValue);
+    if (mRecorder) {
+      mRecorder->record(TrafficRecordType::OUTBOUND_SET, 0, request.value);
+    }
+    outbound.push_back(std::move(request.value));
   }
 
+  // A set doesn't land in the middle of a zoned batch.
+  std::shared_lock<std::shared_mutex> transaction(mStoreTransactionLock);
   auto writeResult = mServerSidePropStore->writeValue(std::move(updatedValue));
   if (!writeResult.ok()) {
     setValueResult.status = StatusCode::INTERNAL_ERROR;
@@ -229,6 +524,151 @@ SetValueResult Ros2VehicleHardware::handleSetValueRequest(const SetValueRequest&
   return setValueResult;
 }
 
+void Ros2VehicleHardware::noteVehicleSample(const VehiclePropValue& value)
+{
+  if (mRecorder) {
+    mRecorder->record(TrafficRecordType::INBOUND_SAMPLE, 0, value);
+  }
+
+  if (mConfig.readThroughTtl.count(value.prop) != 0) {
+    // A pushed sample is as fresh as a fetched one.
+    std::scoped_lock<std::mutex> lockGuard(mFetchLock);
+    mFetchedAt[PropIdAreaId{.propId = value.prop, .areaId = value.areaId}] = std::chrono::steady_clock::now();
+  }
+}
+
+void Ros2VehicleHardware::handlePropertyUpdate(VehiclePropValue value)
+{
+  noteVehicleSample(value);
+
+  auto writeResult = mServerSidePropStore->writeValue(mValuePool->obtain(value), /*updateStatus=*/true);
+  if (!writeResult.ok()) {
+    ALOGW("failed to store vehicle update for prop 0x%x area 0x%x, error: %s", value.prop, value.areaId,
+          getErrorMsg(writeResult).c_str());
+  }
+}
+
+void Ros2VehicleHardware::handlePropertyBatch(std::vector<VehiclePropValue> values)
+{
+  for (const auto& value : values) {
+    noteVehicleSample(value);
+  }
+
+  std::vector<VehiclePropValue> changes;
+  {
+    std::unique_lock<std::shared_mutex> transaction(mStoreTransactionLock);
+    {
+      std::scoped_lock<std::mutex> lockGuard(mLock);
+      mBatchWriter = std::this_thread::get_id();
+    }
+
+    for (const auto& value : values) {
+      auto writeResult = mServerSidePropStore->writeValue(mValuePool->obtain(value), /*updateStatus=*/true);
+      if (!writeResult.ok()) {
+        ALOGW("failed to store vehicle update for prop 0x%x area 0x%x, error: %s", value.prop, value.areaId,
+              getErrorMsg(writeResult).c_str());
+      }
+    }
+
+    std::scoped_lock<std::mutex> lockGuard(mLock);
+    mBatchWriter.reset();
+    changes.swap(mBatchChanges);
+  }
+
+  std::scoped_lock<std::mutex> lockGuard(mLock);
+  if (mOnPropertyChangeCallback && !changes.empty()) {
+    (*mOnPropertyChangeCallback)(std::move(changes));
+  }
+}
+
+bool Ros2VehicleHardware::fetchFromVehicle(const GetValueRequest& request,
+                                           const std::shared_ptr<const GetValuesCallback>& callback)
+{
+  auto ttlIt = mConfig.readThroughTtl.find(request.prop.prop);
+  if (ttlIt == mConfig.readThroughTtl.end()) {
+    return false;
+  }
+  if (shouldShed(request.prop.prop)) {
+    // Served from the store without a round trip to the vehicle.
+    mShedReads++;
+    return false;
+  }
+
+  const PropIdAreaId key{.propId = request.prop.prop, .areaId = request.prop.areaId};
+  const auto now = std::chrono::steady_clock::now();
+  {
+    std::scoped_lock<std::mutex> lockGuard(mFetchLock);
+    if (auto fetchedIt = mFetchedAt.find(key);
+        fetchedIt != mFetchedAt.end() && now - fetchedIt->second < ttlIt->second) {
+      return false;
+    }
+
+    auto [it, inserted] = mInFlightFetches.try_emplace(key);
+    it->second.waiters.push_back({request, callback, android::elapsedRealtimeNano()});
+    if (!inserted) {
+      // Coalesced with the fetch already in flight.
+      return true;
+    }
+    it->second.deadline = now + mConfig.readThroughTimeout;
+  }
+
+  if (!mRos2Bridge->getProperty(key.propId, key.areaId)) {
+    // Vehicle unreachable, serve whatever the store has.
+    completeFetch(key, std::nullopt);
+  }
+  return true;
+}
+
+void Ros2VehicleHardware::completeFetch(const PropIdAreaId& key, std::optional<VehiclePropValue> value)
+{
+  std::vector<RequestWithCallback<GetValuesCallback, GetValueRequest>> waiters;
+  {
+    std::scoped_lock<std::mutex> lockGuard(mFetchLock);
+    if (auto it = mInFlightFetches.find(key); it != mInFlightFetches.end()) {
+      waiters = std::move(it->second.waiters);
+      mInFlightFetches.erase(it);
+    }
+    if (value.has_value()) {
+      mFetchedAt[key] = std::chrono::steady_clock::now();
+    }
+  }
+
+  if (value.has_value()) {
+    auto writeResult = mServerSidePropStore->writeValue(mValuePool->obtain(*value), /*updateStatus=*/true);
+    if (!writeResult.ok()) {
+      ALOGW("failed to store fetched prop 0x%x area 0x%x, error: %s", key.propId, key.areaId,
+            getErrorMsg(writeResult).c_str());
+    }
+  }
+
+  std::unordered_map<std::shared_ptr<const GetValuesCallback>, std::vector<GetValueResult>> callbackToResults;
+  for (const auto& waiter : waiters) {
+    callbackToResults[waiter.callback].push_back(handleGetValueRequest(waiter.request));
+  }
+  for (const auto& [callback, results] : callbackToResults) {
+    (*callback)(std::move(results));
+  }
+}
+
+void Ros2VehicleHardware::expireFetches()
+{
+  std::vector<PropIdAreaId> expired;
+  {
+    const auto now = std::chrono::steady_clock::now();
+    std::scoped_lock<std::mutex> lockGuard(mFetchLock);
+    for (const auto& [key, fetch] : mInFlightFetches) {
+      if (fetch.deadline <= now) {
+        expired.push_back(key);
+      }
+    }
+  }
+
+  for (const auto& key : expired) {
+    ALOGW("fetch of prop 0x%x area 0x%x timed out, answering from the store", key.propId, key.areaId);
+    completeFetch(key, std::nullopt);
+  }
+}
+
 template <class CallbackType, class RequestType>
 Ros2VehicleHardware::PendingRequestHandler<CallbackType, RequestType>::PendingRequestHandler(
     Ros2VehicleHardware* hardware)
@@ -236,9 +676,14 @@ Ros2VehicleHardware::PendingRequestHandler<CallbackType, RequestType>::PendingRe
 {
   // Don't initialize mThread in initialization list because mThread depends on mRequests and we
   // want mRequests to be initialized first.
+  mLastProgressNs = android::elapsedRealtimeNano();
   mThread = std::thread([this] {
     while (mRequests.waitForItems()) {
+      mBusySinceNs = android::elapsedRealtimeNano();
       handleRequestsOnce();
+      mHeartbeats++;
+      mLastProgressNs = android::elapsedRealtimeNano();
+      mBusySinceNs = 0;
     }
   });
 }
@@ -247,12 +692,44 @@ template <class CallbackType, class RequestType>
 void Ros2VehicleHardware::PendingRequestHandler<CallbackType, RequestType>::addRequest(
     RequestType request, std::shared_ptr<const CallbackType> callback)
 {
+  mAdded++;
   mRequests.push({
       request,
       callback,
+      android::elapsedRealtimeNano(),
   });
 }
 
+template <class CallbackType, class RequestType>
+typename Ros2VehicleHardware::PendingRequestHandler<CallbackType, RequestType>::Progress
+Ros2VehicleHardware::PendingRequestHandler<CallbackType, RequestType>::progress() const
+{
+  // Taken before added, so a concurrent addRequest() can't make pending negative.
+  const uint64_t taken = mTaken;
+  return Progress{
+      .heartbeats = mHeartbeats,
+      .pending = mAdded - taken,
+      .lastProgressNs = mLastProgressNs,
+      .busySinceNs = mBusySinceNs,
+      .lastQueueLatencyNs = mLastQueueLatencyNs,
+  };
+}
+
+template <class CallbackType, class RequestType>
+std::vector<Ros2VehicleHardware::RequestWithCallback<CallbackType, RequestType>>
+Ros2VehicleHardware::PendingRequestHandler<CallbackType, RequestType>::takeRequests()
+{
+  auto requests = mRequests.flush();
+  const int64_t now = android::elapsedRealtimeNano();
+  int64_t latency = 0;
+  for (const auto& rwc : requests) {
+    latency = std::max(latency, now - rwc.queuedAt);
+  }
+  mLastQueueLatencyNs = latency;
+  mTaken += requests.size();
+  return requests;
+}
+
 template <class CallbackType, class RequestType>
 void Ros2VehicleHardware::PendingRequestHandler<CallbackType, RequestType>::stop()
 {
@@ -267,7 +744,10 @@ void Ros2VehicleHardware::PendingRequestHandler<Ros2VehicleHardware::GetValuesCa
                                                 GetValueRequest>::handleRequestsOnce()
 {
   std::unordered_map<std::shared_ptr<const GetValuesCallback>, std::vector<GetValueResult>> callbackToResults;
-  for (const auto& rwc : mRequests.flush()) {
+  for (const auto& rwc : takeRequests()) {
+    if (mHardware->fetchFromVehicle(rwc.request, rwc.callback)) {
+      continue;
+    }
     auto result = mHardware->handleGetValueRequest(rwc.request);
     callbackToResults[rwc.callback].push_back(std::move(result));
   }
@@ -281,10 +761,15 @@ void Ros2VehicleHardware::PendingRequestHandler<Ros2VehicleHardware::SetValuesCa
                                                 SetValueRequest>::handleRequestsOnce()
 {
   std::unordered_map<std::shared_ptr<const SetValuesCallback>, std::vector<SetValueResult>> callbackToResults;
-  for (const auto& rwc : mRequests.flush()) {
-    auto result = mHardware->handleSetValueRequest(rwc.request);
+  std::vector<VehiclePropValue> outbound;
+  for (auto& rwc : takeRequests()) {
+    auto result = mHardware->handleSetValueRequest(std::move(rwc.request), outbound);
     callbackToResults[rwc.callback].push_back(std::move(result));
   }
+  // Handed over together, so the areas of a zoned property share one message.
+  if (!outbound.empty()) {
+    (void)mHardware->mRos2Bridge->setProperties(std::move(outbound));
+  }
   for (const auto& [callback, results] : callbackToResults) {
     (*callback)(std::move(results));
   }
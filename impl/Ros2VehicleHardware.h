@@ -21,15 +21,27 @@
 #pragma once
 
 #include "Ros2Bridge.h"
+#include "Ros2Config.h"
+#include "Ros2PropertySnapshot.h"
+#include "Ros2TrafficRecorder.h"
 
 #include <ConcurrentQueue.h>
 #include <IVehicleHardware.h>
 #include <VehiclePropertyStore.h>
 #include <DefaultConfig.h>
+#include <RecurrentTimer.h>
+#include <VehicleUtils.h>
 
+#include <atomic>
+#include <chrono>
 #include <memory>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 #include <mutex>
+#include <shared_mutex>
+#include <thread>
 
 namespace vendor::spyrosoft::vehicle {
 
@@ -48,6 +60,8 @@ class Ros2VehicleHardware : public android::hardware::automotive::vehicle::IVehi
   struct RequestWithCallback {
     RequestType request;
     std::shared_ptr<const CallbackType> callback;
+    // elapsedRealtimeNano() of addRequest().
+    int64_t queuedAt;
   };
 
   /**
@@ -65,17 +79,40 @@ class Ros2VehicleHardware : public android::hardware::automotive::vehicle::IVehi
 
     void stop();
 
+    // Heartbeat of the worker thread, all times in elapsedRealtimeNano().
+    struct Progress {
+      uint64_t heartbeats;
+      // Requests added but not yet taken by the worker.
+      uint64_t pending;
+      int64_t lastProgressNs;
+      // Start of the batch being handled, 0 while the worker waits for requests.
+      int64_t busySinceNs;
+      // Longest wait of a request in the latest batch.
+      int64_t lastQueueLatencyNs;
+    };
+
+    Progress progress() const;
+
    private:
     Ros2VehicleHardware* mHardware;
     std::thread mThread;
     android::hardware::automotive::vehicle::ConcurrentQueue<RequestWithCallback<CallbackType, RequestType>> mRequests;
 
+    std::atomic_uint64_t mAdded{0};
+    std::atomic_uint64_t mTaken{0};
+    std::atomic_uint64_t mHeartbeats{0};
+    std::atomic_int64_t mLastProgressNs{0};
+    std::atomic_int64_t mBusySinceNs{0};
+    std::atomic_int64_t mLastQueueLatencyNs{0};
+
+    // Takes the queued requests and records how long they waited.
+    std::vector<RequestWithCallback<CallbackType, RequestType>> takeRequests();
     void handleRequestsOnce();
   };
 
  public:
-  explicit Ros2VehicleHardware(std::unique_ptr<ros2::ROS2Bridge> ros_bridge);
-  ~Ros2VehicleHardware() override = default;
+  explicit Ros2VehicleHardware(std::unique_ptr<ros2::ROS2Bridge> ros_bridge, Config config = {});
+  ~Ros2VehicleHardware() override;
 
   // Get all the property configs.
   std::vector<aidl::android::hardware::automotive::vehicle::VehiclePropConfig> getAllPropertyConfigs() const override;
@@ -100,6 +137,12 @@ class Ros2VehicleHardware : public android::hardware::automotive::vehicle::IVehi
   // Check whether the system is healthy, return {@code StatusCode::OK} for healthy.
   aidl::android::hardware::automotive::vehicle::StatusCode checkHealth() override;
 
+  // Whether the property store has been populated and requests can be answered.
+  bool isReady() const { return mReady; }
+
+  // Whether the workers and the bridge loops make progress, as reported by checkHealth().
+  bool isHealthy();
+
   // Register a callback that would be called when there is a property change event from vehicle.
   void registerOnPropertyChangeEvent(std::unique_ptr<const PropertyChangeCallback> callback) override;
 
@@ -112,21 +155,105 @@ class Ros2VehicleHardware : public android::hardware::automotive::vehicle::IVehi
                                                                             float sampleRate) override;
 
  protected:
-  void storePropInitialValue(const android::hardware::automotive::vehicle::defaultconfig::ConfigDeclaration& config);
+  void storeInitialValues(const std::vector<aidl::android::hardware::automotive::vehicle::VehiclePropValue>& values,
+                          int64_t timestamp);
 
   aidl::android::hardware::automotive::vehicle::GetValueResult handleGetValueRequest(
       const aidl::android::hardware::automotive::vehicle::GetValueRequest& request);
 
+  // Stores the value and, while the bridge is connected, moves it into outbound for the vehicle.
   aidl::android::hardware::automotive::vehicle::SetValueResult handleSetValueRequest(
-      const aidl::android::hardware::automotive::vehicle::SetValueRequest& request);
+      aidl::android::hardware::automotive::vehicle::SetValueRequest request,
+      std::vector<aidl::android::hardware::automotive::vehicle::VehiclePropValue>& outbound);
+
+  // Loads the snapshot once its directory exists, on the timer thread after construction.
+  void loadSnapshot();
+  void saveSnapshot();
+
+  // Property sample published by the vehicle, called on the bridge thread.
+  void handlePropertyUpdate(aidl::android::hardware::automotive::vehicle::VehiclePropValue value);
+
+  // All areas of a zoned batch, stored in one transaction and reported in one change event.
+  void handlePropertyBatch(std::vector<aidl::android::hardware::automotive::vehicle::VehiclePropValue> values);
+
+  // Recording and read-through bookkeeping of an inbound sample.
+  void noteVehicleSample(const aidl::android::hardware::automotive::vehicle::VehiclePropValue& value);
+
+  // Read-through of vehicle-owned properties. Returns true when the request is answered once the
+  // vehicle responds, false when it should be served from the store right away.
+  bool fetchFromVehicle(const aidl::android::hardware::automotive::vehicle::GetValueRequest& request,
+                        const std::shared_ptr<const GetValuesCallback>& callback);
+
+  // Stores the fetched value, if any, and answers every reader waiting on the property area.
+  void completeFetch(const android::hardware::automotive::vehicle::PropIdAreaId& key,
+                     std::optional<aidl::android::hardware::automotive::vehicle::VehiclePropValue> value);
+
+  void expireFetches();
+
+  // Checks the worker and bridge heartbeats against the stall timeout and the queue latency SLO,
+  // updates mHealthy and mDegraded. Degraded lasts until the SLO was met for the recovery window.
+  void evaluateHealth();
+
+  // Whether queued requests of the property are dropped in degraded mode. Samples from the vehicle
+  // are always stored, they are what the shed reads fall back to.
+  bool shouldShed(int32_t propId) const;
 
  protected:
+  const Config mConfig;
   std::unique_ptr<ros2::ROS2Bridge> mRos2Bridge;
 
   const std::shared_ptr<android::hardware::automotive::vehicle::VehiclePropValuePool> mValuePool;
   const std::unique_ptr<android::hardware::automotive::vehicle::VehiclePropertyStore> mServerSidePropStore;
 
+  std::atomic_bool mReady{false};
+
+  std::mutex mHealthLock;
+  std::atomic_bool mHealthy{true};
+  std::atomic_bool mDegraded{false};
+  // elapsedRealtimeNano() of the last queue latency over the SLO, guarded by mHealthLock.
+  int64_t mLastSloBreachNs = 0;
+  std::atomic_uint64_t mShedSets{0};
+  std::atomic_uint64_t mShedReads{0};
+  std::shared_ptr<android::hardware::automotive::vehicle::RecurrentTimer::Callback> mHealthCallback;
+
+  // Left out of the snapshot, filled in the constructor.
+  std::unordered_set<int32_t> mContinuousProps;
+  // Bumped on every change of a property that is snapshotted, the snapshot is only rewritten when it moved.
+  std::atomic_uint64_t mStoreGeneration{0};
+  uint64_t mSnapshotGeneration = 0;
+  std::unique_ptr<PropertySnapshot> mSnapshot;
+  std::atomic_bool mSnapshotLoaded{false};
+  int64_t mSnapshotTimestamp = 0;
+  // Reset first on destruction, its callbacks use most other members.
+  std::unique_ptr<android::hardware::automotive::vehicle::RecurrentTimer> mRecurrentTimer;
+  std::unique_ptr<TrafficRecorder> mRecorder;
+
+  // All readers of one property area share a single request to the vehicle.
+  struct InFlightFetch {
+    std::chrono::steady_clock::time_point deadline;
+    std::vector<RequestWithCallback<GetValuesCallback, aidl::android::hardware::automotive::vehicle::GetValueRequest>>
+        waiters;
+  };
+
+  std::mutex mFetchLock;
+  std::unordered_map<android::hardware::automotive::vehicle::PropIdAreaId, InFlightFetch,
+                     android::hardware::automotive::vehicle::PropIdAreaIdHash>
+      mInFlightFetches;
+  std::unordered_map<android::hardware::automotive::vehicle::PropIdAreaId, std::chrono::steady_clock::time_point,
+                     android::hardware::automotive::vehicle::PropIdAreaIdHash>
+      mFetchedAt;
+  std::shared_ptr<android::hardware::automotive::vehicle::RecurrentTimer::Callback> mFetchExpiryCallback;
+  std::shared_ptr<android::hardware::automotive::vehicle::RecurrentTimer::Callback> mSnapshotCallback;
+  std::shared_ptr<android::hardware::automotive::vehicle::RecurrentTimer::Callback> mSnapshotLoadCallback;
+  std::shared_ptr<android::hardware::automotive::vehicle::RecurrentTimer::Callback> mRecordFlushCallback;
+
+  // Held shared by store readers and set requests, and exclusively while a zoned batch is written.
+  mutable std::shared_mutex mStoreTransactionLock;
+
   std::mutex mLock;
+  // Thread writing a zoned batch, its store changes are collected in mBatchChanges.
+  std::optional<std::thread::id> mBatchWriter;
+  std::vector<aidl::android::hardware::automotive::vehicle::VehiclePropValue> mBatchChanges;
   std::unique_ptr<const PropertyChangeCallback> mOnPropertyChangeCallback;
   std::unique_ptr<const PropertySetErrorCallback> mOnPropertySetErrorCallback;
 
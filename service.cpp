@@ -23,24 +23,47 @@
 
 #include <DefaultVehicleHal.h>
 #include <aidl/android/automotive/watchdog/BnCarWatchdogClient.h>
+#include <aidl/android/automotive/watchdog/ICarWatchdog.h>
+#include <android-base/properties.h>
 #include <android/binder_manager.h>
 #include <android/binder_process.h>
 
+#include <map>
+#include <thread>
+
 #include "Ros2Bridge.h"
+#include "Ros2Config.h"
 #include "Ros2Logger.h"
+#include "Ros2MicroRosTransport.h"
+#include "Ros2PoolAllocator.h"
+#include "Ros2PropertyDomain.h"
 #include "impl/Ros2VehicleHardware.h"
 
 using android::hardware::automotive::vehicle::DefaultVehicleHal;
 using namespace vendor::spyrosoft::vehicle;
 
+// Answers the car watchdog only while the request workers and the bridge loops make progress, a
+// stalled pipeline is left unanswered so the watchdog can restart the service.
 class WatchdogClient : public aidl::android::automotive::watchdog::BnCarWatchdogClient {
  public:
+  WatchdogClient(std::shared_ptr<aidl::android::automotive::watchdog::ICarWatchdog> watchdog,
+                 Ros2VehicleHardware* hardware)
+      : m_watchdog(std::move(watchdog)), m_hardware(hardware)
+  {
+  }
   ~WatchdogClient() override = default;
 
-  ndk::ScopedAStatus checkIfAlive(int32_t /*sessionId*/,
+  ndk::ScopedAStatus checkIfAlive(int32_t sessionId,
                                   aidl::android::automotive::watchdog::TimeoutLength /*timeout*/) override
   {
-    ALOGI("checkIfAlive");
+    if (!m_hardware->isHealthy()) {
+      ALOGW("checkIfAlive: pipeline stalled, not answering session %d", sessionId);
+      return ndk::ScopedAStatus::ok();
+    }
+    auto status = m_watchdog->tellClientAlive(ref<WatchdogClient>(), sessionId);
+    if (!status.isOk()) {
+      ALOGW("checkIfAlive: failed to answer session %d: %s", sessionId, status.getDescription().c_str());
+    }
     return ndk::ScopedAStatus::ok();
   }
 
@@ -49,14 +72,79 @@ class WatchdogClient : public aidl::android::automotive::watchdog::BnCarWatchdog
     ALOGI("prepareProcessTermination");
     return ndk::ScopedAStatus::ok();
   }
+
+ private:
+  const std::shared_ptr<aidl::android::automotive::watchdog::ICarWatchdog> m_watchdog;
+  // Owned by the DefaultVehicleHal, which outlives the binder thread pool.
+  Ros2VehicleHardware* const m_hardware;
 };
 
+// The car watchdog daemon may start after the VHAL, it is waited for on a thread of its own so the
+// service comes up regardless.
+void registerWatchdogClient(Ros2VehicleHardware* hardware)
+{
+  std::thread([hardware]() {
+    using aidl::android::automotive::watchdog::ICarWatchdog;
+
+    ndk::SpAIBinder binder(AServiceManager_waitForService("android.automotive.watchdog.ICarWatchdog/default"));
+    auto watchdog = ICarWatchdog::fromBinder(binder);
+    if (!watchdog) {
+      ALOGW("car watchdog not available, health is only reported through checkHealth");
+      return;
+    }
+
+    auto client = ndk::SharedRefBase::make<WatchdogClient>(watchdog, hardware);
+    auto status =
+        watchdog->registerClient(client, aidl::android::automotive::watchdog::TimeoutLength::TIMEOUT_NORMAL);
+    if (!status.isOk()) {
+      ALOGW("failed to register with the car watchdog: %s", status.getDescription().c_str());
+      return;
+    }
+    ALOGI("registered with the car watchdog");
+  }).detach();
+}
+
+// One session for properties of the configured domains each, plus a default session for the rest.
+std::unique_ptr<ros2::ROS2Bridge> makeBridge(const Config& config)
+{
+  std::vector<std::unique_ptr<ros2::Transport>> transports;
+  std::map<PropertyDomain, size_t> sessionOfDomain;
+
+  auto addSession = [&](const std::string& name) {
+    ros2::MicroRosTransport::Options options;
+    options.nodeName = (name == "default") ? "android_vhal_node" : "android_vhal_node_" + name;
+    if (auto it = config.agentAddresses.find(name); it != config.agentAddresses.end()) {
+      options.agentAddress = it->second;
+    }
+    transports.push_back(std::make_unique<ros2::MicroRosTransport>(options));
+    return transports.size() - 1;
+  };
+
+  addSession("default");
+  for (const auto domain : config.sessionDomains) {
+    if (sessionOfDomain.count(domain) == 0) {
+      sessionOfDomain[domain] = addSession(toString(domain));
+    }
+  }
+
+  return std::make_unique<ros2::ROS2Bridge>(std::move(transports), [sessionOfDomain](int32_t propId) {
+    auto it = sessionOfDomain.find(getPropertyDomain(propId));
+    return (it != sessionOfDomain.end()) ? it->second : size_t{0};
+  });
+}
+
 int main(int /* argc */, char* /* argv */[])
 {
-  ros2::Logger logger{};
+  auto config = loadConfig();
+  // Before anything else allocates through rcutils.
+  if (config.allocatorPoolSize > 0) {
+    ros2::PoolAllocator::install(config.allocatorPoolSize);
+  }
 
-  auto bridge = std::make_unique<ros2::ROS2Bridge>();
-  auto hardware = std::make_unique<Ros2VehicleHardware>(std::move(bridge));
+  ros2::Logger logger{};
+  auto bridge = makeBridge(config);
+  auto hardware = std::make_unique<Ros2VehicleHardware>(std::move(bridge), std::move(config));
+  Ros2VehicleHardware* const healthSource = hardware.get();
   auto vhal = ::ndk::SharedRefBase::make<DefaultVehicleHal>(std::move(hardware));
 
   auto err = AServiceManager_addService(vhal->asBinder().get(), "android.hardware.automotive.vehicle.IVehicle/default");
@@ -71,8 +159,12 @@ int main(int /* argc */, char* /* argv */[])
   }
   ABinderProcess_startThreadPool();
 
-  auto watchdogClient = ndk::SharedRefBase::make<WatchdogClient>();
+  registerWatchdogClient(healthSource);
 
+  // Clients and init triggers can wait for this instead of polling the service.
+  if (healthSource->isReady() && !android::base::SetProperty("vendor.ros2vhal.ready", "1")) {
+    ALOGW("failed to publish vendor.ros2vhal.ready");
+  }
   ALOGI("Vehicle Service Ready");
   ABinderProcess_joinThreadPool();
 
@@ -0,0 +1,187 @@
+/*
+ * Copyright (c) 2023 Spyrosoft Synergy S.A.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Runs Ros2VehicleHardware and the bridge against an in-process loopback agent, publishes
+// synthetic vehicle signals and issues HVAC_FAN_SPEED sets, then reports what got through.
+//
+// usage: ros2-vhal-loadgen [--latency-us N] [--loss P] [--ack-failure P] [--agent-drop P]
+//                          [--outage-ms N] [--props N] [--rate-hz N] [--sets-per-s N]
+//                          [--duration-s N] [--seed N] [--clock-offset-ms N]
+
+#include "common/logging.hpp"
+
+#include <VehicleUtils.h>
+#include <getopt.h>
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+#include "Ros2Bridge.h"
+#include "Ros2LoopbackTransport.h"
+#include "Ros2VehicleHardware.h"
+
+using aidl::android::hardware::automotive::vehicle::SetValueRequest;
+using aidl::android::hardware::automotive::vehicle::SetValueResult;
+using aidl::android::hardware::automotive::vehicle::VehicleProperty;
+using aidl::android::hardware::automotive::vehicle::VehiclePropertyType;
+using aidl::android::hardware::automotive::vehicle::VehiclePropValue;
+using android::hardware::automotive::vehicle::IVehicleHardware;
+using namespace vendor::spyrosoft::vehicle;
+
+int main(int argc, char* argv[])
+{
+  ros2::LoopbackTransport::Options options;
+  size_t props = 8;
+  uint32_t setsPerSecond = 10;
+  uint32_t durationSeconds = 10;
+  options.syntheticRateHz = 10;
+
+  static const option kOptions[] = {
+      {"latency-us", required_argument, nullptr, 'l'}, {"loss", required_argument, nullptr, 'p'},
+      {"ack-failure", required_argument, nullptr, 'a'}, {"agent-drop", required_argument, nullptr, 'd'},
+      {"outage-ms", required_argument, nullptr, 'o'}, {"props", required_argument, nullptr, 'n'},
+      {"rate-hz", required_argument, nullptr, 'r'}, {"sets-per-s", required_argument, nullptr, 's'},
+      {"duration-s", required_argument, nullptr, 't'}, {"seed", required_argument, nullptr, 'S'},
+      {"clock-offset-ms", required_argument, nullptr, 'c'},
+      {nullptr, 0, nullptr, 0},
+  };
+
+  int opt;
+  while ((opt = getopt_long(argc, argv, "", kOptions, nullptr)) != -1) {
+    switch (opt) {
+      case 'l':
+        options.latency = std::chrono::microseconds(atoll(optarg));
+        break;
+      case 'p':
+        options.lossRate = atof(optarg);
+        break;
+      case 'a':
+        options.ackFailureRate = atof(optarg);
+        break;
+      case 'd':
+        options.agentDropRate = atof(optarg);
+        break;
+      case 'o':
+        options.outageDuration = std::chrono::milliseconds(atoll(optarg));
+        break;
+      case 'n':
+        props = static_cast<size_t>(atoll(optarg));
+        break;
+      case 'r':
+        options.syntheticRateHz = static_cast<uint32_t>(atoll(optarg));
+        break;
+      case 's':
+        setsPerSecond = static_cast<uint32_t>(atoll(optarg));
+        break;
+      case 't':
+        durationSeconds = static_cast<uint32_t>(atoll(optarg));
+        break;
+      case 'S':
+        options.seed = static_cast<uint32_t>(atoll(optarg));
+        break;
+      case 'c':
+        options.clockOffset = std::chrono::milliseconds(atoll(optarg));
+        break;
+      default:
+        fprintf(stderr, "unknown option, see the header of %s for usage\n", __FILE__);
+        return 1;
+    }
+  }
+
+  // Synthetic signals are taken from the global scalar properties the store knows about.
+  for (const auto& config : android::hardware::automotive::vehicle::defaultconfig::getDefaultConfigs()) {
+    const int32_t propId = config.config.prop;
+    const auto type = android::hardware::automotive::vehicle::getPropType(propId);
+    if (options.syntheticPropIds.size() < props && android::hardware::automotive::vehicle::isGlobalProp(propId) &&
+        (type == VehiclePropertyType::FLOAT || type == VehiclePropertyType::INT32 ||
+         type == VehiclePropertyType::INT64)) {
+      options.syntheticPropIds.push_back(propId);
+    }
+  }
+
+  Config config;
+  config.snapshotPath.clear();
+  // The load is measured as generated, shedding part of it would flatter the results.
+  config.degradedMode = false;
+
+  auto transport = std::make_unique<ros2::LoopbackTransport>(options);
+  ros2::LoopbackTransport* loopback = transport.get();
+  auto bridge = std::make_unique<ros2::ROS2Bridge>(std::move(transport));
+  ros2::ROS2Bridge* ros2Bridge = bridge.get();
+  Ros2VehicleHardware hardware(std::move(bridge), config);
+
+  std::atomic_size_t changeEvents{0};
+  std::atomic_size_t setResults{0};
+  hardware.registerOnPropertyChangeEvent(std::make_unique<const IVehicleHardware::PropertyChangeCallback>(
+      [&changeEvents](std::vector<VehiclePropValue> values) { changeEvents += values.size(); }));
+  auto setCallback = std::make_shared<const IVehicleHardware::SetValuesCallback>(
+      [&setResults](std::vector<SetValueResult> results) { setResults += results.size(); });
+
+  const auto start = std::chrono::steady_clock::now();
+  const auto end = start + std::chrono::seconds(durationSeconds);
+  const auto setPeriod = setsPerSecond > 0 ? std::chrono::microseconds(1000000 / setsPerSecond)
+                                           : std::chrono::microseconds(durationSeconds * 1000000LL);
+  int64_t requestId = 0;
+
+  for (auto next = start; next < end; next += setPeriod) {
+    std::this_thread::sleep_until(next);
+    VehiclePropValue value = {
+        .areaId = 0x1,  // SEAT_1_LEFT
+        .prop = static_cast<int32_t>(VehicleProperty::HVAC_FAN_SPEED),
+    };
+    value.value.int32Values = {static_cast<int32_t>(requestId % 6) + 1};
+    hardware.setValues(setCallback, {SetValueRequest{.requestId = ++requestId, .value = value}});
+  }
+
+  // Let in-flight responses arrive before taking the numbers.
+  std::this_thread::sleep_for(options.latency * 2 + std::chrono::milliseconds(200));
+
+  const auto bridgeStats = ros2Bridge->stats();
+  const auto loopbackStats = loopback->stats();
+  printf("duration %u s, %zu synthetic signals at %u Hz\n", durationSeconds, options.syntheticPropIds.size(),
+         options.syntheticRateHz);
+  printf("agent: %llu pings, %llu failed, %llu sessions\n", static_cast<unsigned long long>(loopbackStats.pings),
+         static_cast<unsigned long long>(loopbackStats.pingFailures),
+         static_cast<unsigned long long>(loopbackStats.sessions));
+  printf("bridge: %llu connects, %llu disconnects\n", static_cast<unsigned long long>(bridgeStats.connects),
+         static_cast<unsigned long long>(bridgeStats.disconnects));
+  printf("sets: %lld issued, %zu answered, %llu sent, %llu send failures, %llu acked, %llu rejected, %llu lost\n",
+         static_cast<long long>(requestId), setResults.load(), static_cast<unsigned long long>(bridgeStats.setsSent),
+         static_cast<unsigned long long>(bridgeStats.setSendFailures),
+         static_cast<unsigned long long>(bridgeStats.setsAcked),
+         static_cast<unsigned long long>(bridgeStats.setsRejected),
+         static_cast<unsigned long long>(loopbackStats.setsLost));
+  printf("samples: %llu published, %llu lost, %llu received, %zu change events\n",
+         static_cast<unsigned long long>(loopbackStats.samplesPublished),
+         static_cast<unsigned long long>(loopbackStats.samplesLost),
+         static_cast<unsigned long long>(bridgeStats.samplesReceived), changeEvents.load());
+  printf("inbound latency: %s\n", bridgeStats.inboundLatency.toString().c_str());
+  printf("outbound queueing: %s\n", bridgeStats.outboundQueueing.toString().c_str());
+  printf("set round trip: %s\n", bridgeStats.setRoundTrip.toString().c_str());
+  for (const auto& clock : bridgeStats.clocks) {
+    printf("clock: %s, offset %lld ns, drift %.3f ppm, %llu syncs\n", clock.synced ? "synced" : "not synced",
+           static_cast<long long>(clock.offsetNs), clock.driftPpm, static_cast<unsigned long long>(clock.syncs));
+  }
+  return 0;
+}
@@ -0,0 +1,302 @@
+/*
+ * Copyright (c) 2023 Spyrosoft Synergy S.A.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Replays a log captured with debug.ros2vhal.record_path against Ros2VehicleHardware and a
+// stand-in transport, and reports throughput and request latency.
+//
+// usage: ros2-vhal-replay <log> [--fast]
+
+#include "common/logging.hpp"
+
+#include <utils/SystemClock.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#include "Ros2Bridge.h"
+#include "Ros2TrafficRecorder.h"
+#include "Ros2Transport.h"
+#include "Ros2VehicleHardware.h"
+
+using aidl::android::hardware::automotive::vehicle::GetValueRequest;
+using aidl::android::hardware::automotive::vehicle::GetValueResult;
+using aidl::android::hardware::automotive::vehicle::SetValueRequest;
+using aidl::android::hardware::automotive::vehicle::SetValueResult;
+using aidl::android::hardware::automotive::vehicle::VehiclePropValue;
+using android::hardware::automotive::vehicle::IVehicleHardware;
+using namespace vendor::spyrosoft::vehicle;
+
+namespace {
+
+/**
+ * @brief Transport with an always reachable agent, outbound sets are counted and inbound samples
+ * are injected by the replayer. Injected samples are queued and delivered from spin(), on the
+ * session thread like those of a real transport.
+ *
+ */
+class ReplayTransport : public ros2::Transport {
+ public:
+  bool discoverAgent() override { return true; }
+  bool pingAgent() override { return true; }
+  void createEntities() override {}
+  void destroyEntities() override {}
+
+  bool sendSetRequest(const ros2_android_vhal__srv__SetVehicleProperty_Request&) override
+  {
+    mOutboundSets++;
+    return true;
+  }
+
+  // Read-through gets fall back to the store, the capture has no vehicle answers to replay.
+  bool sendGetRequest(const ros2_android_vhal__srv__GetVehicleProperty_Request&) override { return false; }
+
+  void spin(std::chrono::nanoseconds timeout) override
+  {
+    std::deque<VehiclePropValue> samples;
+    {
+      std::unique_lock<std::mutex> lock(mLock);
+      mCv.wait_for(lock, timeout, [this]() { return mWakeup || !mSamples.empty(); });
+      mWakeup = false;
+      samples.swap(mSamples);
+    }
+
+    for (const auto& value : samples) {
+      deliver(value);
+    }
+  }
+
+  void wakeup() override
+  {
+    {
+      std::lock_guard<std::mutex> lock(mLock);
+      mWakeup = true;
+    }
+    mCv.notify_one();
+  }
+
+  void inject(const VehiclePropValue& value)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mLock);
+      mSamples.push_back(value);
+    }
+    mCv.notify_one();
+  }
+
+  size_t outboundSets() const { return mOutboundSets; }
+
+ private:
+  std::atomic_size_t mOutboundSets{0};
+  std::mutex mLock;
+  std::condition_variable mCv;
+  bool mWakeup = false;
+  std::deque<VehiclePropValue> mSamples;
+
+  void deliver(const VehiclePropValue& value)
+  {
+    ros2_android_vhal__msg__VehicleProperty msg;
+    ros2_android_vhal__msg__VehicleProperty__init(&msg);
+    msg.timestamp = value.timestamp;
+    msg.area_id = value.areaId;
+    msg.prop_id = value.prop;
+    msg.int64_values = {const_cast<int64_t*>(value.value.int64Values.data()), value.value.int64Values.size(),
+                        value.value.int64Values.size()};
+    msg.int32_values = {const_cast<int32_t*>(value.value.int32Values.data()), value.value.int32Values.size(),
+                        value.value.int32Values.size()};
+    msg.float_values = {const_cast<float*>(value.value.floatValues.data()), value.value.floatValues.size(),
+                        value.value.floatValues.size()};
+    msg.uint8_values = {const_cast<uint8_t*>(value.value.byteValues.data()), value.value.byteValues.size(),
+                        value.value.byteValues.size()};
+    rosidl_runtime_c__String stringValue = {const_cast<char*>(value.value.stringValue.data()),
+                                            value.value.stringValue.size(), value.value.stringValue.size()};
+    if (!value.value.stringValue.empty()) {
+      msg.string_values = {&stringValue, 1, 1};
+    }
+
+    if (m_onSample) {
+      m_onSample(msg);
+    }
+    // The sequences borrow the value's storage, nothing to fini.
+  }
+};
+
+/**
+ * @brief Send timestamps of in-flight requests and the latencies of completed ones.
+ *
+ */
+class LatencyTracker {
+ public:
+  void sent(int64_t requestId)
+  {
+    std::lock_guard<std::mutex> lock(mLock);
+    mInFlight[requestId] = android::elapsedRealtimeNano();
+  }
+
+  void completed(int64_t requestId)
+  {
+    const int64_t now = android::elapsedRealtimeNano();
+    std::lock_guard<std::mutex> lock(mLock);
+    if (auto it = mInFlight.find(requestId); it != mInFlight.end()) {
+      mLatencies.push_back(now - it->second);
+      mInFlight.erase(it);
+    }
+    mCv.notify_all();
+  }
+
+  bool waitForAll(std::chrono::milliseconds timeout)
+  {
+    std::unique_lock<std::mutex> lock(mLock);
+    return mCv.wait_for(lock, timeout, [this]() { return mInFlight.empty(); });
+  }
+
+  void report(const char* name)
+  {
+    std::lock_guard<std::mutex> lock(mLock);
+    if (mLatencies.empty()) {
+      printf("%-4s: no requests\n", name);
+      return;
+    }
+
+    std::sort(mLatencies.begin(), mLatencies.end());
+    auto percentile = [this](size_t p) { return mLatencies[(mLatencies.size() - 1) * p / 100] / 1000; };
+    printf("%-4s: %zu requests, latency us p50 %lld p99 %lld max %lld, %zu lost\n", name, mLatencies.size(),
+           static_cast<long long>(percentile(50)), static_cast<long long>(percentile(99)),
+           static_cast<long long>(mLatencies.back() / 1000), mInFlight.size());
+  }
+
+ private:
+  std::mutex mLock;
+  std::condition_variable mCv;
+  std::unordered_map<int64_t, int64_t> mInFlight;
+  std::vector<int64_t> mLatencies;
+};
+
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s <log> [--fast]\n", argv[0]);
+    return 1;
+  }
+  const bool fast = (argc > 2 && strcmp(argv[2], "--fast") == 0);
+
+  TrafficLogReader reader(argv[1]);
+  if (!reader.isOpen()) {
+    fprintf(stderr, "failed to open traffic log %s\n", argv[1]);
+    return 1;
+  }
+
+  Config config;
+  config.snapshotPath.clear();
+  config.recordPath.clear();
+  // A replay reproduces every recorded request, a fast one overloads the workers on purpose.
+  config.degradedMode = false;
+
+  auto transport = std::make_unique<ReplayTransport>();
+  ReplayTransport* replayTransport = transport.get();
+  auto bridge = std::make_unique<ros2::ROS2Bridge>(std::move(transport));
+  ros2::ROS2Bridge* replayBridge = bridge.get();
+  Ros2VehicleHardware hardware(std::move(bridge), config);
+
+  while (!replayBridge->is_connected()) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  std::atomic_size_t changeEvents{0};
+  hardware.registerOnPropertyChangeEvent(
+      std::make_unique<const IVehicleHardware::PropertyChangeCallback>(
+          [&changeEvents](std::vector<VehiclePropValue> values) { changeEvents += values.size(); }));
+
+  LatencyTracker getLatency;
+  LatencyTracker setLatency;
+  auto getCallback = std::make_shared<const IVehicleHardware::GetValuesCallback>(
+      [&getLatency](std::vector<GetValueResult> results) {
+        for (const auto& result : results) {
+          getLatency.completed(result.requestId);
+        }
+      });
+  auto setCallback = std::make_shared<const IVehicleHardware::SetValuesCallback>(
+      [&setLatency](std::vector<SetValueResult> results) {
+        for (const auto& result : results) {
+          setLatency.completed(result.requestId);
+        }
+      });
+
+  TrafficRecord record;
+  int64_t requestId = 0;
+  int64_t firstTimestamp = -1;
+  size_t records = 0;
+  size_t expectedOutboundSets = 0;
+  const int64_t start = android::elapsedRealtimeNano();
+
+  while (reader.next(record)) {
+    records++;
+    if (firstTimestamp < 0) {
+      firstTimestamp = record.timestamp;
+    }
+
+    if (!fast) {
+      const int64_t due = start + (record.timestamp - firstTimestamp);
+      const int64_t now = android::elapsedRealtimeNano();
+      if (due > now) {
+        std::this_thread::sleep_for(std::chrono::nanoseconds(due - now));
+      }
+    }
+
+    switch (record.type) {
+      case TrafficRecordType::GET_REQUEST:
+        getLatency.sent(++requestId);
+        hardware.getValues(getCallback, {GetValueRequest{.requestId = requestId, .prop = record.value}});
+        break;
+      case TrafficRecordType::SET_REQUEST:
+        setLatency.sent(++requestId);
+        hardware.setValues(setCallback, {SetValueRequest{.requestId = requestId, .value = record.value}});
+        break;
+      case TrafficRecordType::OUTBOUND_SET:
+        expectedOutboundSets++;
+        break;
+      case TrafficRecordType::INBOUND_SAMPLE:
+        replayTransport->inject(record.value);
+        break;
+    }
+  }
+
+  const bool drained = getLatency.waitForAll(std::chrono::seconds(10)) && setLatency.waitForAll(std::chrono::seconds(10));
+  const double seconds = static_cast<double>(android::elapsedRealtimeNano() - start) / 1e9;
+
+  printf("replayed %zu records in %.3f s (%s), %.0f records/s\n", records, seconds, fast ? "fast" : "1x",
+         static_cast<double>(records) / seconds);
+  getLatency.report("get");
+  setLatency.report("set");
+  printf("outbound sets: %zu (recorded %zu), change events: %zu\n", replayTransport->outboundSets(),
+         expectedOutboundSets, changeEvents.load());
+
+  return drained ? 0 : 2;
+}